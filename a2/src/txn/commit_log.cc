@@ -0,0 +1,83 @@
+#include "commit_log.h"
+
+#include <sched.h>
+
+#include "key_intersect.h"
+
+// Spins before a reader waiting for an entry to be appended yields the CPU.
+#define COMMIT_LOG_SPINS_BEFORE_YIELD 64
+
+CommitLog::CommitLog(uint64 capacity) : tail_(0)
+{
+    capacity_ = 1;
+    while (capacity_ < capacity) capacity_ <<= 1;
+    mask_    = capacity_ - 1;
+    entries_ = NewCacheAlignedArray<Entry>(capacity_);
+}
+
+CommitLog::~CommitLog() { DeleteCacheAlignedArray(entries_, capacity_); }
+
+void CommitLog::Append(const KeyValueMap& writes, const KeySignature& signature)
+{
+    uint64 i     = tail_.fetch_add(1);
+    Entry* entry = &entries_[i & mask_];
+
+    // The previous occupant may still be in the middle of being appended.
+    if (i >= capacity_)
+    {
+        uint64 previous = 2 * (i - capacity_) + 2;
+        while (entry->seq_.load(std::memory_order_acquire) < previous) sched_yield();
+    }
+
+    entry->seq_.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int w = 0; w < KeySignature::kWords; w++)
+        __atomic_store_n(&entry->signature_.words_[w], signature.words_[w], __ATOMIC_RELAXED);
+    if (writes.size() > (size_t)kMaxKeys)
+    {
+        __atomic_store_n(&entry->count_, kAllKeys, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        uint32 n = 0;
+        for (KeyValueMap::const_iterator it = writes.begin(); it != writes.end(); ++it, ++n)
+            __atomic_store_n(&entry->keys_[n], it->first, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->count_, n, __ATOMIC_RELAXED);
+    }
+    entry->seq_.store(2 * i + 2, std::memory_order_release);
+}
+
+bool CommitLog::Conflicts(uint64 from, const KeySet& keys, const KeySignature& signature) const
+{
+    uint64 end = tail_.load();
+    if (end - from > capacity_) return true;
+
+    for (uint64 i = from; i < end; i++)
+    {
+        const Entry* entry = &entries_[i & mask_];
+        uint64 want        = 2 * i + 2;
+        uint64 seq;
+        int spins = 0;
+        while ((seq = entry->seq_.load(std::memory_order_acquire)) < want)
+        {
+            if (++spins > COMMIT_LOG_SPINS_BEFORE_YIELD) sched_yield();
+        }
+        if (seq != want) return true;
+
+        // Signatures first, then the keys. What is read here only counts if
+        // the entry wasn't overwritten meanwhile (the kernel's loads may race
+        // with the overwrite; the sequence check below discards their result).
+        uint64 common = 0;
+        for (int w = 0; w < KeySignature::kWords; w++)
+            common |= __atomic_load_n(&entry->signature_.words_[w], __ATOMIC_RELAXED) & signature.words_[w];
+        bool hit = false;
+        if (common != 0)
+        {
+            uint32 count = __atomic_load_n(&entry->count_, __ATOMIC_RELAXED);
+            hit          = (count > (uint32)kMaxKeys) || SortedKeysIntersect(entry->keys_, count, keys.data(), keys.size());
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (hit || entry->seq_.load(std::memory_order_relaxed) != want) return true;
+    }
+    return false;
+}
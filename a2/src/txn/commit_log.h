@@ -0,0 +1,75 @@
+#ifndef _COMMIT_LOG_H_
+#define _COMMIT_LOG_H_
+
+#include <atomic>
+
+#include "key_signature.h"
+#include "txn.h"
+
+// Fixed-capacity ring of the write sets of committed txns, for OCC backward
+// validation. Commits are numbered in the order they are appended; a txn
+// remembers Tail() when it starts and, at validation, checks the commits
+// logged since against its read and write sets.
+//
+// The log keeps copies of the keys, never the Txn's themselves (which their
+// client may delete as soon as they are returned). Neither appending nor
+// validating takes a lock: every entry carries a sequence word, written
+// seqlock-style, that tells a reader whether the entry it looked at still
+// holds the commit it wanted. The ring is truncated implicitly: entry i is
+// reclaimed by commit i + capacity, by which time every txn that started
+// before commit i has either validated or is overrun. An overrun txn fails
+// validation (and restarts), so memory and validation cost stay bounded no
+// matter how long the processor runs.
+class CommitLog
+{
+   public:
+    // Largest write set logged exactly. A larger one is logged as conflicting
+    // with every read set.
+    static const int kMaxKeys = 30;
+
+    // Number of commits the default-constructed log holds.
+    static const uint64 kDefaultCapacity = 1 << 14;
+
+    // 'capacity' is rounded up to a power of two.
+    explicit CommitLog(uint64 capacity = kDefaultCapacity);
+    ~CommitLog();
+
+    // Number of the next commit to be appended. Safe to call from any thread.
+    uint64 Tail() const { return tail_.load(); }
+
+    // Logs the keys of 'writes' as the next commit. 'signature' must cover
+    // them (it may cover more keys). Safe to call from any thread.
+    void Append(const KeyValueMap& writes, const KeySignature& signature);
+
+    // Returns true if some commit numbered 'from' or higher, and appended
+    // before the call, wrote a key in 'keys', or if some of those commits were
+    // already overwritten. 'signature' must cover 'keys'; keys are only
+    // compared for commits whose signature intersects it. Waits for commits
+    // that are still being appended. Safe to call from any thread.
+    bool Conflicts(uint64 from, const KeySet& keys, const KeySignature& signature) const;
+
+   private:
+    struct alignas(CACHE_LINE_SIZE) Entry
+    {
+        Entry() : seq_(0), count_(0) {}
+
+        // 2i + 1 while commit i is being written to the entry, 2i + 2 once it
+        // is complete (0: never written).
+        std::atomic<uint64> seq_;
+
+        uint32 count_;  // Number of keys, or kAllKeys
+        Key keys_[kMaxKeys];  // Sorted
+        KeySignature signature_;
+    };
+
+    static const uint32 kAllKeys = ~0u;
+
+    Entry* entries_;
+    uint64 capacity_;
+    uint64 mask_;  // capacity_ - 1
+
+    // Number of commits reserved so far.
+    std::atomic<uint64> tail_;
+};
+
+#endif  // _COMMIT_LOG_H_
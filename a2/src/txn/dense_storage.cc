@@ -0,0 +1,87 @@
+#include "dense_storage.h"
+
+#include <sys/mman.h>
+
+DenseStorage::DenseStorage(Key dense_keys) : dense_keys_(dense_keys)
+{
+    // Anonymous mappings are zero-filled on first touch, which is exactly the
+    // "never written" state of a Record.
+    void* mem = mmap(NULL, dense_keys_ * sizeof(Record), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) DIE("Failed to map " << dense_keys_ << " dense records.");
+    dense_ = static_cast<Record*>(mem);
+
+    stripes_ = NewCacheAlignedArray<Stripe>(kStripes);
+}
+
+DenseStorage::~DenseStorage()
+{
+    munmap(dense_, dense_keys_ * sizeof(Record));
+    DeleteCacheAlignedArray(stripes_, kStripes);
+}
+
+bool DenseStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    bool found;
+    if (key < dense_keys_)
+    {
+        Mutex& latch = LatchFor(key);
+        latch.Lock();
+        found = dense_[key].occupied_;
+        if (found) *result = dense_[key].value_;
+        latch.Unlock();
+    }
+    else
+    {
+        overflow_latch_.ReadLock();
+        Record* record = overflow_.Find(key);
+        found          = record != NULL;
+        if (found) *result = record->value_;
+        overflow_latch_.Unlock();
+    }
+    return found || ReadImage(key, result);
+}
+
+void DenseStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    if (key < dense_keys_)
+    {
+        Mutex& latch = LatchFor(key);
+        latch.Lock();
+        Record* record           = &dense_[key];
+        record->key_             = key;
+        record->value_           = value;
+        record->timestamp_       = GetTime();
+        record->committed_index_ = txn_unique_id;
+        record->occupied_        = 1;
+        latch.Unlock();
+    }
+    else
+    {
+        overflow_latch_.WriteLock();
+        Record* record           = overflow_.Insert(key);
+        record->value_           = value;
+        record->timestamp_       = GetTime();
+        record->committed_index_ = txn_unique_id;
+        overflow_latch_.Unlock();
+    }
+}
+
+double DenseStorage::Timestamp(Key key)
+{
+    double timestamp = 0;
+    if (key < dense_keys_)
+    {
+        Mutex& latch = LatchFor(key);
+        latch.Lock();
+        if (dense_[key].occupied_) timestamp = dense_[key].timestamp_;
+        latch.Unlock();
+    }
+    else
+    {
+        overflow_latch_.ReadLock();
+        Record* record = overflow_.Find(key);
+        if (record != NULL) timestamp = record->timestamp_;
+        overflow_latch_.Unlock();
+    }
+    return timestamp;
+}
@@ -0,0 +1,48 @@
+#ifndef _DENSE_STORAGE_H_
+#define _DENSE_STORAGE_H_
+
+#include "record_table.h"
+#include "storage.h"
+#include "utils/mutex.h"
+
+// Thread-safe single-version storage for contiguous integer key spaces. Keys
+// in [0, dense_keys) live in a preallocated array indexed directly by key (no
+// hashing); any other key falls back to a hashed overflow table. The array is
+// mapped lazily by the OS, so construction costs O(1) regardless of its size.
+class DenseStorage : public Storage
+{
+   public:
+    explicit DenseStorage(Key dense_keys = kDefaultDenseKeys);
+    virtual ~DenseStorage();
+
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key);
+
+    // Matches the key range populated by InitStorage().
+    static const Key kDefaultDenseKeys = kInitKeys;
+
+   private:
+    // Latches for the dense array. Record 'key' is guarded by stripe
+    // 'key % kStripes', so neighbouring keys never share a latch.
+    struct alignas(CACHE_LINE_SIZE) Stripe
+    {
+        Mutex latch_;
+    };
+    static const int kStripes = 1024;
+
+    inline Mutex& LatchFor(Key key) { return stripes_[key & (kStripes - 1)].latch_; }
+
+    // Records for keys [0, dense_keys_). A record whose 'occupied_' is zero has
+    // never been written.
+    Record* dense_;
+    Key dense_keys_;
+
+    Stripe* stripes_;
+
+    // Records for keys >= dense_keys_.
+    MutexRW overflow_latch_;
+    RecordTable overflow_;
+};
+
+#endif  // _DENSE_STORAGE_H_
@@ -0,0 +1,101 @@
+#include "key_intersect.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define KEY_INTERSECT_X86 1
+#endif
+
+bool SortedKeysIntersectScalar(const Key* a, size_t na, const Key* b, size_t nb)
+{
+    size_t i = 0, j = 0;
+    while (i < na && j < nb)
+    {
+        if (a[i] < b[j])
+            i++;
+        else if (b[j] < a[i])
+            j++;
+        else
+            return true;
+    }
+    return false;
+}
+
+#ifdef KEY_INTERSECT_X86
+
+// Both block loops compare a block of 'a' against every key of the block of
+// 'b', then move past whichever block ends with the smaller key: none of its
+// keys can equal a key further on in the other array. What is left over is
+// merged by the scalar loop.
+
+__attribute__((target("sse4.2"))) static bool SortedKeysIntersectSSE42(const Key* a, size_t na, const Key* b,
+                                                                        size_t nb)
+{
+    size_t i = 0, j = 0;
+    while (i + 2 <= na && j + 2 <= nb)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi64(va, vb),
+                                  _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        if (!_mm_testz_si128(eq, eq)) return true;
+        Key a_last = a[i + 1], b_last = b[j + 1];
+        if (a_last <= b_last) i += 2;
+        if (b_last <= a_last) j += 2;
+    }
+    return SortedKeysIntersectScalar(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx2"))) static bool SortedKeysIntersectAVX2(const Key* a, size_t na, const Key* b, size_t nb)
+{
+    size_t i = 0, j = 0;
+    while (i + 4 <= na && j + 4 <= nb)
+    {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi64(va, vb),
+                            _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                            _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        if (!_mm256_testz_si256(eq, eq)) return true;
+        Key a_last = a[i + 3], b_last = b[j + 3];
+        if (a_last <= b_last) i += 4;
+        if (b_last <= a_last) j += 4;
+    }
+    return SortedKeysIntersectScalar(a + i, na - i, b + j, nb - j);
+}
+
+#endif  // KEY_INTERSECT_X86
+
+typedef bool (*IntersectFn)(const Key*, size_t, const Key*, size_t);
+
+struct IntersectKernel
+{
+    IntersectFn fn_;
+    const char* name_;
+};
+
+static IntersectKernel ChooseKernel()
+{
+    IntersectKernel kernel = {SortedKeysIntersectScalar, "scalar"};
+#ifdef KEY_INTERSECT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernel.fn_   = SortedKeysIntersectAVX2;
+        kernel.name_ = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        kernel.fn_   = SortedKeysIntersectSSE42;
+        kernel.name_ = "sse4.2";
+    }
+#endif
+    return kernel;
+}
+
+static const IntersectKernel kKernel = ChooseKernel();
+
+bool SortedKeysIntersect(const Key* a, size_t na, const Key* b, size_t nb) { return kKernel.fn_(a, na, b, nb); }
+
+const char* SortedKeysIntersectKernel() { return kKernel.name_; }
@@ -0,0 +1,30 @@
+#ifndef _KEY_INTERSECT_H_
+#define _KEY_INTERSECT_H_
+
+#include <stddef.h>
+
+#include "utils/common.h"
+
+// Conflict-detection kernel shared by the OCC validators: returns true iff the
+// sorted, duplicate-free key arrays 'a' (of 'na' keys) and 'b' (of 'nb' keys)
+// have a key in common.
+//
+// Uses AVX2 or SSE4.2 if the CPU has them (checked once, at startup),
+// comparing the arrays block against block, and a scalar merge otherwise.
+bool SortedKeysIntersect(const Key* a, size_t na, const Key* b, size_t nb);
+
+// Same, for any two sorted containers of contiguous keys (KeySet, vector<Key>).
+template <typename A, typename B>
+static inline bool SortedKeysIntersect(const A& a, const B& b)
+{
+    return SortedKeysIntersect(a.data(), a.size(), b.data(), b.size());
+}
+
+// The scalar merge, whatever the CPU.
+bool SortedKeysIntersectScalar(const Key* a, size_t na, const Key* b, size_t nb);
+
+// Name of the implementation SortedKeysIntersect() uses ("avx2", "sse4.2" or
+// "scalar").
+const char* SortedKeysIntersectKernel();
+
+#endif  // _KEY_INTERSECT_H_
@@ -0,0 +1,87 @@
+// Microbenchmark of the read/write-set conflict check done by the OCC
+// validators: the nested std::set loops they used before, the scalar merge of
+// sorted key arrays, and SortedKeysIntersect() on this CPU, for the set sizes
+// of the benchmark workloads (5, 10 and 30 keys) drawn from the low- and
+// high-contention key spaces (1M and 100 records).
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "key_intersect.h"
+
+using std::cout;
+using std::endl;
+using std::set;
+using std::vector;
+
+static const int kPairs  = 1000;
+static const int kRounds = 2000;
+
+// Pre-kernel check: every key of 'a' against every key of 'b'.
+static bool NestedSetsIntersect(const set<Key>& a, const set<Key>& b)
+{
+    for (set<Key>::const_iterator it = a.begin(); it != a.end(); ++it)
+        for (set<Key>::const_iterator it1 = b.begin(); it1 != b.end(); ++it1)
+            if (*it == *it1) return true;
+    return false;
+}
+
+static set<Key> RandomKeys(int size, int dbsize)
+{
+    set<Key> keys;
+    while ((int)keys.size() < size) keys.insert(rand() % dbsize);
+    return keys;
+}
+
+int main(int argc, char** argv)
+{
+    int sizes[]   = {5, 10, 30};
+    int dbsizes[] = {1000000, 100};
+
+    cout << "kernel: " << SortedKeysIntersectKernel() << endl;
+    cout << "keys\trecords\t\thits\tstd::set (ns/op)\tscalar (ns/op)\tkernel (ns/op)" << endl;
+
+    uint64 checksum = 0;
+    for (int d = 0; d < 2; d++)
+    {
+        for (int s = 0; s < 3; s++)
+        {
+            vector<set<Key> > sets_a, sets_b;
+            vector<vector<Key> > arrays_a, arrays_b;
+            for (int i = 0; i < kPairs; i++)
+            {
+                sets_a.push_back(RandomKeys(sizes[s], dbsizes[d]));
+                sets_b.push_back(RandomKeys(sizes[s], dbsizes[d]));
+                arrays_a.push_back(vector<Key>(sets_a[i].begin(), sets_a[i].end()));
+                arrays_b.push_back(vector<Key>(sets_b[i].begin(), sets_b[i].end()));
+            }
+
+            int hits     = 0;
+            double start = GetTime();
+            for (int r = 0; r < kRounds; r++)
+                for (int i = 0; i < kPairs; i++) hits += NestedSetsIntersect(sets_a[i], sets_b[i]);
+            double nested = GetTime() - start;
+
+            start = GetTime();
+            for (int r = 0; r < kRounds; r++)
+                for (int i = 0; i < kPairs; i++)
+                    checksum += SortedKeysIntersectScalar(arrays_a[i].data(), arrays_a[i].size(), arrays_b[i].data(),
+                                                          arrays_b[i].size());
+            double scalar = GetTime() - start;
+
+            start = GetTime();
+            for (int r = 0; r < kRounds; r++)
+                for (int i = 0; i < kPairs; i++) checksum += SortedKeysIntersect(arrays_a[i], arrays_b[i]);
+            double kernel = GetTime() - start;
+
+            double ops = (double)kRounds * kPairs;
+            cout << sizes[s] << "\t" << dbsizes[d] << "\t\t" << hits / kRounds
+                 << "\t" << nested * 1e9 / ops << "\t\t\t" << scalar * 1e9 / ops << "\t\t" << kernel * 1e9 / ops
+                 << endl;
+        }
+    }
+
+    // Keep the checks from being optimized away.
+    return checksum == 42 ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _KEY_SIGNATURE_H_
+#define _KEY_SIGNATURE_H_
+
+#include "utils/common.h"
+
+// Fixed-width bitmap summary of a set of keys (a Bloom filter with a single
+// hash function). Two sets can only intersect if their signatures do, so
+// validators AND signatures first and only compare the keys themselves on a
+// hit.
+//
+// A key sets bit 'key mod kBits': keys are usually dense small integers, so
+// any kBits consecutive keys get distinct bits, and key sets drawn from a
+// small hot range have exact signatures.
+struct KeySignature
+{
+    static const int kBits  = 1024;
+    static const int kWords = kBits / 64;
+
+    KeySignature() { Clear(); }
+
+    void Clear()
+    {
+        for (int i = 0; i < kWords; i++) words_[i] = 0;
+    }
+
+    void Add(Key key) { words_[(key / 64) % kWords] |= 1ULL << (key % 64); }
+
+    // Adds every key of the container 'keys'.
+    template <typename Keys>
+    void AddAll(const Keys& keys)
+    {
+        for (typename Keys::const_iterator it = keys.begin(); it != keys.end(); ++it) Add(*it);
+    }
+
+    // Adds every key of 'other'.
+    void Add(const KeySignature& other)
+    {
+        for (int i = 0; i < kWords; i++) words_[i] |= other.words_[i];
+    }
+
+    // Returns false if the two summarized sets are certainly disjoint.
+    bool Intersects(const KeySignature& other) const
+    {
+        uint64 common = 0;
+        for (int i = 0; i < kWords; i++) common |= words_[i] & other.words_[i];
+        return common != 0;
+    }
+
+    uint64 words_[kWords];
+};
+
+#endif  // _KEY_SIGNATURE_H_
@@ -0,0 +1,240 @@
+#include "lock_free_mvcc_storage.h"
+
+#include <sched.h>
+
+// Raises 'value' to at least 'candidate'.
+static inline void AtomicFetchMax(std::atomic<int>* value, int candidate)
+{
+    int current = value->load();
+    while (current < candidate && !value->compare_exchange_weak(current, candidate))
+    {
+    }
+}
+
+LockFreeMVCCStorage::LockFreeMVCCStorage(uint64 capacity)
+    : slots_(capacity, MVCCStorage::kPartitions * 64, "LockFreeMVCCStorage"),
+      records_(0),
+      gc_cursor_(0),
+      sweep_chained_(0),
+      sweep_longest_(0),
+      versions_reclaimed_(0),
+      chained_versions_(0),
+      longest_chain_(0)
+{
+}
+
+// Every version belongs to 'pool_', which releases them itself.
+LockFreeMVCCStorage::~LockFreeMVCCStorage() {}
+
+void LockFreeMVCCStorage::Seed(Slot* slot)
+{
+    Value value;
+    if (ReadImage(slot->key_, &value))
+    {
+        AtomicVersion* version = pool_.New();
+        version->value_        = value;
+        version->max_read_id_.store(0);
+        version->version_id_ = 0;
+        version->status_.store(VERSION_COMMITTED);
+        version->next_.store(NULL);
+        slot->head_.store(version);
+        records_.fetch_add(1);
+    }
+}
+
+LockFreeMVCCStorage::Slot* LockFreeMVCCStorage::ExistingSlotFor(Key key)
+{
+    Slot* slot = slots_.Find(key);
+    Value value;
+    if (slot == NULL && ReadImage(key, &value)) slot = SlotFor(key);
+    return slot;
+}
+
+LockFreeMVCCStorage::ReadResult LockFreeMVCCStorage::TryRead(Key key, int ts, Value* result)
+{
+    Slot* slot = ExistingSlotFor(key);
+    if (slot == NULL) return READ_NOT_FOUND;
+    for (AtomicVersion* version = slot->head_.load(); version != NULL; version = version->next_.load())
+    {
+        int status = version->status_.load();
+        if (status == VERSION_ABORTED || version->version_id_ > ts) continue;
+        // A pending version below 'ts' may still commit, and then it is the
+        // one this read has to return.
+        if (status == VERSION_PENDING) return READ_CONFLICT;
+
+        *result = version->value_;
+        AtomicFetchMax(&version->max_read_id_, ts);
+
+        // A writer with a timestamp in (version_id_, ts] that installed before
+        // the fetch-max above may have validated without seeing it (Validate()
+        // checks max_read_id_ after installing, this checks the chain after
+        // raising max_read_id_, so at least one side notices the other).
+        for (AtomicVersion* newer = slot->head_.load(); newer != version; newer = newer->next_.load())
+            if (newer->version_id_ <= ts && newer->status_.load() != VERSION_ABORTED) return READ_CONFLICT;
+        return READ_OK;
+    }
+    return READ_NOT_FOUND;
+}
+
+bool LockFreeMVCCStorage::SnapshotRead(Key key, Value* result, int ts)
+{
+    // A key without a slot was never written: it only has its image version.
+    Slot* slot = slots_.Find(key);
+    if (slot == NULL) return ReadImage(key, result);
+    for (AtomicVersion* version = slot->head_.load(); version != NULL; version = version->next_.load())
+    {
+        if (version->version_id_ <= ts && version->status_.load() == VERSION_COMMITTED)
+        {
+            *result = version->value_;
+            return true;
+        }
+    }
+    return false;
+}
+
+AtomicVersion* LockFreeMVCCStorage::Install(Key key, Value value, int ts)
+{
+    Slot* slot             = SlotFor(key);
+    AtomicVersion* version = NULL;
+    AtomicVersion* head;
+    while (true)
+    {
+        head                = slot->head_.load();
+        AtomicVersion* live = SkipAborted(head);
+        if (live != NULL && (live->status_.load() == VERSION_PENDING || live->version_id_ > ts ||
+                             live->max_read_id_.load() > ts))
+        {
+            if (version != NULL) pool_.Delete(version);
+            return NULL;
+        }
+
+        if (version == NULL)
+        {
+            version         = pool_.New();
+            version->value_ = value;
+            version->max_read_id_.store(ts);
+            version->version_id_ = ts;
+            version->status_.store(VERSION_PENDING);
+        }
+        version->next_.store(head);
+        if (slot->head_.compare_exchange_strong(head, version)) break;
+    }
+
+    if (head != NULL)
+        slots_.Mark(slot);
+    else
+        records_.fetch_add(1);
+    return version;
+}
+
+bool LockFreeMVCCStorage::Validate(AtomicVersion* version)
+{
+    AtomicVersion* replaced = SkipAborted(version->next_.load());
+    return replaced == NULL || replaced->max_read_id_.load() <= version->version_id_;
+}
+
+bool LockFreeMVCCStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    ReadResult read;
+    while ((read = TryRead(key, txn_unique_id, result)) == READ_CONFLICT) sched_yield();
+    return read == READ_OK;
+}
+
+void LockFreeMVCCStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    Slot* slot             = SlotFor(key);
+    AtomicVersion* version = pool_.New();
+    version->value_        = value;
+    version->max_read_id_.store(txn_unique_id);
+    version->version_id_ = txn_unique_id;
+    version->status_.store(VERSION_COMMITTED);
+
+    AtomicVersion* head = slot->head_.load();
+    do
+    {
+        version->next_.store(head);
+    } while (!slot->head_.compare_exchange_weak(head, version));
+
+    if (head != NULL)
+        slots_.Mark(slot);
+    else
+        records_.fetch_add(1);
+}
+
+void LockFreeMVCCStorage::CollectGarbage(int low_watermark, int num_partitions)
+{
+    uint64 reclaimed = 0;
+    for (int n = 0; n < num_partitions; n++)
+    {
+        for (int level = 0; level < SlotTable<Slot>::kMaxLevels && slots_.Slots(level) != NULL; level++)
+        {
+            Slot* slots                = slots_.Slots(level);
+            std::atomic<uint64>* marks = slots_.Marks(level);
+            uint64 words               = slots_.Capacity(level) / 64 / MVCCStorage::kPartitions;
+            for (uint64 w = gc_cursor_ * words; w < (gc_cursor_ + 1) * words; w++)
+            {
+                uint64 bits = marks[w].load();
+                while (bits != 0)
+                {
+                    uint64 index = w * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    Slot* slot = &slots[index];
+
+                    // Find the newest committed version every active and future
+                    // txn can see. No reader or writer ever walks past it, so the
+                    // versions behind it can be unlinked and freed right away.
+                    AtomicVersion* visible = slot->head_.load();
+                    uint64 length          = 1;
+                    while (visible != NULL && !(visible->status_.load() == VERSION_COMMITTED &&
+                                                visible->version_id_ <= low_watermark))
+                    {
+                        visible = visible->next_.load();
+                        length++;
+                    }
+                    if (visible == NULL) continue;
+
+                    AtomicVersion* garbage = visible->next_.exchange(NULL);
+                    // Clear the bit before re-checking the head: a writer that
+                    // installs concurrently either sees the bit cleared and sets
+                    // it again, or is seen here.
+                    if (slot->head_.load() == visible)
+                    {
+                        marks[w].fetch_and(~(1ULL << (index % 64)));
+                        if (slot->head_.load() != visible) slots_.Mark(slot);
+                    }
+
+                    while (garbage != NULL)
+                    {
+                        AtomicVersion* next = garbage->next_.load();
+                        pool_.Delete(garbage);
+                        garbage = next;
+                        reclaimed++;
+                    }
+                    sweep_chained_ += length - 1;
+                    if (length > sweep_longest_) sweep_longest_ = length;
+                }
+            }
+        }
+
+        if (++gc_cursor_ == MVCCStorage::kPartitions)
+        {
+            chained_versions_.store(sweep_chained_);
+            longest_chain_.store(sweep_longest_);
+            gc_cursor_     = 0;
+            sweep_chained_ = 0;
+            sweep_longest_ = 0;
+        }
+    }
+    versions_reclaimed_.fetch_add(reclaimed);
+}
+
+GCStats LockFreeMVCCStorage::Stats() const
+{
+    GCStats stats;
+    stats.versions_reclaimed = versions_reclaimed_.load();
+    stats.version_lists      = records_.load();
+    stats.live_versions      = stats.version_lists + chained_versions_.load();
+    stats.longest_chain      = longest_chain_.load();
+    if (stats.longest_chain == 0 && stats.version_lists > 0) stats.longest_chain = 1;
+    return stats;
+}
@@ -0,0 +1,129 @@
+#ifndef _LOCK_FREE_MVCC_STORAGE_H_
+#define _LOCK_FREE_MVCC_STORAGE_H_
+
+#include <atomic>
+
+#include "mvcc_storage.h"
+#include "slot_table.h"
+#include "storage.h"
+#include "utils/object_pool.h"
+
+// Lifecycle of an AtomicVersion. A version is installed PENDING and then
+// moves to COMMITTED or ABORTED exactly once.
+enum VersionStatus
+{
+    VERSION_PENDING   = 0,
+    VERSION_COMMITTED = 1,
+    VERSION_ABORTED   = 2,
+};
+
+// MVCC version that is published, read and retired without locks.
+struct AtomicVersion
+{
+    Value value_;                        // The value of this version
+    std::atomic<int> max_read_id_;       // Largest timestamp of a transaction that read the version
+    int version_id_;                     // Timestamp of the transaction that created(wrote) the version
+    std::atomic<int> status_;            // A VersionStatus
+    std::atomic<AtomicVersion*> next_;   // Next older version of the same key (NULL if none)
+};
+
+// Lock-free MVCC storage for multiversion timestamp ordering. Each key owns a
+// slot holding the head of its version chain (newest first). Writers install
+// a PENDING version with a CAS on the head, readers advance max_read_id_ with
+// an atomic fetch-max, and neither ever waits on the other: whichever side
+// loses a race finds out and restarts its transaction instead.
+//
+// Versions are only unlinked by CollectGarbage(), below the newest committed
+// version every active transaction can see, so readers can walk chains
+// without any reclamation protocol of their own.
+class LockFreeMVCCStorage : public Storage
+{
+   public:
+    // 'capacity' is rounded up, and grows, as in MVCCStorage.
+    explicit LockFreeMVCCStorage(uint64 capacity = MVCCStorage::kDefaultCapacity);
+    virtual ~LockFreeMVCCStorage();
+
+    enum ReadResult
+    {
+        READ_OK        = 0,  // '*result' holds the value visible at the timestamp
+        READ_NOT_FOUND = 1,  // The key has no version visible at the timestamp
+        READ_CONFLICT  = 2,  // A concurrent write may be visible; restart the txn
+    };
+
+    // Reads the version of 'key' visible at timestamp 'ts' (the newest
+    // committed version with version_id_ <= ts) and raises its max_read_id_
+    // to at least 'ts'. Never blocks.
+    ReadResult TryRead(Key key, int ts, Value* result);
+
+    // Like TryRead(), but leaves max_read_id_ alone, so it never conflicts
+    // with writers. Only meaningful for a 'ts' no writer can still install
+    // versions below.
+    bool SnapshotRead(Key key, Value* result, int ts);
+
+    // Installs 'value' as a PENDING version of 'key' with timestamp 'ts' and
+    // returns it. Returns NULL, installing nothing, if the write would violate
+    // timestamp order or another write to 'key' is pending; the txn must then
+    // restart.
+    AtomicVersion* Install(Key key, Value value, int ts);
+
+    // Returns true if no transaction newer than the writer of 'version' has
+    // read the version it replaced. Call once all of a txn's writes are
+    // installed; a txn may only commit if every one of them validates.
+    bool Validate(AtomicVersion* version);
+
+    // Makes a pending version visible, or discards it.
+    void Commit(AtomicVersion* version) { version->status_.store(VERSION_COMMITTED); }
+    void Abort(AtomicVersion* version) { version->status_.store(VERSION_ABORTED); }
+
+    // Non-transactional access, for tools and tests: Read() retries until no
+    // write is pending, Write() installs a committed version unconditionally.
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key) { return 0; }
+
+    // Same contract as MVCCStorage::CollectGarbage(). Never takes a lock.
+    void CollectGarbage(int low_watermark, int num_partitions);
+
+    GCStats Stats() const;
+
+   private:
+    struct Slot
+    {
+        std::atomic<uint32> state_;  // See SlotTable
+        Key key_;
+        std::atomic<AtomicVersion*> head_;
+    };
+
+    // Returns the slot of 'key', claiming one if it has none. A new slot is
+    // seeded with the key's value from the attached image (if any).
+    inline Slot* SlotFor(Key key)
+    {
+        return slots_.FindOrClaim(key, [this](Slot* slot) { this->Seed(slot); });
+    }
+    void Seed(Slot* slot);
+
+    // See MVCCStorage::ExistingSlotFor().
+    Slot* ExistingSlotFor(Key key);
+
+    // Returns the first version at or after 'version' that is not ABORTED.
+    static inline AtomicVersion* SkipAborted(AtomicVersion* version)
+    {
+        while (version != NULL && version->status_.load() == VERSION_ABORTED) version = version->next_.load();
+        return version;
+    }
+
+    // Mark bits as in MVCCStorage.
+    SlotTable<Slot> slots_;
+    ObjectPool<AtomicVersion> pool_;
+    std::atomic<uint64> records_;
+
+    int gc_cursor_;
+    uint64 sweep_chained_;
+    uint64 sweep_longest_;
+
+    std::atomic<uint64> versions_reclaimed_;
+    std::atomic<uint64> chained_versions_;
+    std::atomic<uint64> longest_chain_;
+};
+
+#endif  // _LOCK_FREE_MVCC_STORAGE_H_
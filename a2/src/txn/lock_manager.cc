@@ -1,231 +1,287 @@
 #include "lock_manager.h"
-#include <set>
-using std::deque;
 
+LockManager::LockManager(deque<Txn*>* ready_txns, DeadlockPolicy policy)
+    : LockManager([ready_txns](Txn* txn) { ready_txns->push_back(txn); }, policy)
+{
+}
 
-LockManagerA::LockManagerA(deque<Txn*>* ready_txns) { ready_txns_ = ready_txns; }
+LockManager::LockManager(const ReadyCallback& on_ready, DeadlockPolicy policy) : on_ready_(on_ready), policy_(policy)
+{
+    partitions_ = NewCacheAlignedArray<Partition>(kPartitions);
+    txn_owners_ = NewCacheAlignedArray<OwnerStripe>(kOwnerStripes);
+}
 
+LockManager::~LockManager()
+{
+    // Heads, requests and owners go with their pools.
+    DeleteCacheAlignedArray(partitions_, kPartitions);
+    DeleteCacheAlignedArray(txn_owners_, kOwnerStripes);
+}
 
-bool LockManagerA::WriteLock(Txn* txn, const Key& key) {
-    
-   // Implement this method!
-    LockRequest l(LockMode::EXCLUSIVE,txn);
-    if(lock_table_[key]) {
-        lock_table_[key]->push_back(l);
-    } else {
-        deque<LockRequest>* queue = new deque<LockRequest>();
-        queue->push_back(l);
-        lock_table_[key] = queue;
+bool LockManager::Request(Txn* txn, const Key& key, LockMode mode)
+{
+    OwnerStripe& stripe = StripeOf(txn);
+    stripe.latch_.Lock();
+    LockOwner*& owner = stripe.owners_[txn];
+    if (owner == NULL)
+    {
+        owner       = owners_.New();
+        owner->txn_ = txn;
     }
+    LockOwner* requester = owner;
+    stripe.latch_.Unlock();
 
-    if(lock_table_[key]->size() == 1) {
-        return true;
-    } else {
-        txn_waits_[txn]++; 
-        return false;
-    }
+    return Request(requester, key, mode);
 }
 
-bool LockManagerA::ReadLock(Txn* txn, const Key& key)
+bool LockManager::Request(LockOwner* owner, const Key& key, LockMode mode)
 {
-    // Since Part 1A implements ONLY exclusive locks, calls to ReadLock can
-    // simply use the same logic as 'WriteLock'.
-    return WriteLock(txn, key);
+    LockRequest* request = requests_.New();
+    request->owner_      = owner;
+    request->mode_       = mode;
+
+    // Linked in first: once granted, the txn may carry on in another thread.
+    request->owner_next_ = owner->requests_;
+    owner->requests_     = request;
+
+    Partition& partition = PartitionOf(key);
+    partition.latch_.Lock();
+
+    LockHead*& head = partition.lock_table_[key];
+    if (head == NULL)
+    {
+        head       = heads_.New();
+        head->key_ = key;
+    }
+    request->head_ = head;
+    request->prev_ = head->last_;
+    if (head->last_ != NULL)
+        head->last_->next_ = request;
+    else
+        head->first_ = request;
+    head->last_ = request;
+
+    // Granted iff nobody waits ahead of it and it is compatible with the
+    // holders: there are none, or they and it are all SHARED.
+    bool granted = head->waiting_ == NULL &&
+                   (head->holders_ == 0 || (mode == SHARED && head->first_->mode_ == SHARED));
+    SmallVector<Txn*, 8> ready;
+    if (granted)
+    {
+        request->granted_ = true;
+        head->holders_++;
+    }
+    else
+    {
+        if (head->waiting_ == NULL) head->waiting_ = request;
+        // Counted under the latch, so before anyone can grant it.
+        int waits = owner->waits_.fetch_add(1);
+
+        // A victim that was not blocked when chosen is reported now.
+        if ((waits & LockOwner::kAborted) != 0)
+            Abort(owner, &ready);
+        else if (policy_ != ORDERED)
+            PreventDeadlock(request, &ready);
+    }
+
+    partition.latch_.Unlock();
+    for (uint32 i = 0; i < ready.size(); i++) on_ready_(ready[i]);
+    return granted;
 }
 
-void LockManagerA::Release(Txn* txn, const Key& key) {
-    //
-    // Implement this method!
-    
-    if(lock_table_[key]) {
-        Txn* tx1 = lock_table_[key]->front().txn_;
-        if(tx1 == txn) {
-            lock_table_[key]->pop_front();
-            txn_waits_.erase(txn);
-            if(lock_table_[key]->size() > 0) {
-                Txn* txn1 = lock_table_[key]->front().txn_;
-                txn_waits_[txn1] = txn_waits_[txn1] - 1;
-                if(txn_waits_[txn1] == 0) {
-                    ready_txns_->push_back(txn1);
-                }
-            }
-        } else {
-           deque<LockRequest>* queue = lock_table_[key];
-           deque<LockRequest>::iterator it1;
-           for(it1=queue->begin(); it1 != queue->end();++it1) {
-              if(it1->txn_ == txn) {
-                lock_table_[key]->erase(it1);
-                break;
-              }
-            }
-            txn_waits_.erase(txn);
+void LockManager::PreventDeadlock(LockRequest* request, SmallVector<Txn*, 8>* ready)
+{
+    // The request waits for every request ahead of it that it conflicts
+    // with (any other one only keeps it waiting through those).
+    LockOwner* owner = request->owner_;
+    for (LockRequest* ahead = request->head_->first_; ahead != request; ahead = ahead->next_)
+    {
+        if (ahead->owner_ == owner || (ahead->mode_ == SHARED && request->mode_ == SHARED)) continue;
+        if (policy_ == WAIT_DIE && ahead->owner_->ts_ < owner->ts_)
+        {
+            // Dies; its request goes when it releases its locks.
+            Abort(owner, ready);
+            return;
         }
+        if (policy_ == WOUND_WAIT && ahead->owner_->ts_ > owner->ts_) Abort(ahead->owner_, ready);
     }
 }
 
-// NOTE: The owners input vector is NOT assumed to be empty.
-LockMode LockManagerA::Status(const Key& key, vector<Txn*>* owners)
+void LockManager::Abort(LockOwner* owner, SmallVector<Txn*, 8>* ready)
 {
-    //
-    // Implement this method!
-    if(lock_table_.find(key) == lock_table_.end()) {
-        return LockMode::UNLOCKED;
-    } else {
-        owners->clear();
-        deque<LockRequest>* queue = lock_table_[key];
-        owners->push_back(queue->front().txn_);
-        return LockMode::EXCLUSIVE;
+    // Report a blocked victim now, and only once: whoever grants its last
+    // blocked request leaves it alone.
+    int waits = owner->waits_.load();
+    while (true)
+    {
+        int aborted = waits | LockOwner::kAborted;
+        if ((waits & LockOwner::kWaitsMask) > 0) aborted |= LockOwner::kReported;
+        if (aborted == waits) return;
+        if (owner->waits_.compare_exchange_weak(waits, aborted))
+        {
+            if ((aborted & ~waits & LockOwner::kReported) != 0) ready->Insert(ready->end(), owner->txn_);
+            return;
+        }
     }
 }
 
+void LockManager::Remove(Txn* txn, const Key& key)
+{
+    OwnerStripe& stripe = StripeOf(txn);
+    stripe.latch_.Lock();
+    unordered_map<Txn*, LockOwner*>::iterator entry = stripe.owners_.find(txn);
+    LockOwner* owner = (entry == stripe.owners_.end()) ? NULL : entry->second;
+    stripe.latch_.Unlock();
+    if (owner == NULL) return;
 
+    // A txn has few requests; find the one for 'key'.
+    LockRequest** link = &owner->requests_;
+    while (*link != NULL && (*link)->head_->key_ != key) link = &(*link)->owner_next_;
+    if (*link == NULL) return;
+    LockRequest* request = *link;
+    *link                = request->owner_next_;
+    Dequeue(request);
 
-LockManagerB::LockManagerB(deque<Txn*>* ready_txns) {
-     ready_txns_ = ready_txns;
-      }
+    if (owner->Empty())
+    {
+        stripe.latch_.Lock();
+        stripe.owners_.erase(txn);
+        stripe.latch_.Unlock();
+        owners_.Delete(owner);
+    }
+}
 
-bool LockManagerB::WriteLock(Txn* txn, const Key& key)
+void LockManager::ReleaseAll(LockOwner* owner)
 {
-    //
-    // // Implement this method!
-    LockRequest l(LockMode::EXCLUSIVE,txn);
-    if(lock_table_[key]) {
-        lock_table_[key]->push_back(l);
-    } else {
-        deque<LockRequest>* queue = new deque<LockRequest>();
-        queue->push_back(l);
-        lock_table_[key] = queue;
+    while (owner->requests_ != NULL)
+    {
+        LockRequest* request = owner->requests_;
+        owner->requests_     = request->owner_next_;
+        Dequeue(request);
     }
-    if(lock_table_[key]->size() == 1) {
-        return true;
-    } else {
-        txn_waits_[txn]++; 
-        return false;
-    }
-     
+
+    // No request left to choose the owner as a victim through.
+    owner->waits_.store(0);
 }
 
-bool LockManagerB::ReadLock(Txn* txn, const Key& key) {
-
-    
-    // //Implement this method!
-    LockRequest l(LockMode::SHARED,txn);
-    if(lock_table_[key]) {
-        lock_table_[key]->push_back(l);
-    } else {
-        deque<LockRequest>* queue = new deque<LockRequest>();
-        queue->push_back(l);
-        lock_table_[key] = queue;
+void LockManager::Dequeue(LockRequest* request)
+{
+    LockHead* head       = request->head_;
+    Partition& partition = PartitionOf(head->key_);
+    partition.latch_.Lock();
+
+    if (request->granted_)
+    {
+        head->holders_--;
     }
-    if(lock_table_[key]->size() == 1) {
-        return true;
-    } else {
-        deque<LockRequest>* queue = lock_table_[key];
-        deque<LockRequest>::iterator it1;
-        bool isContainsExclusiveLock = false;
-        for(it1=queue->begin()+1; it1 != queue->end();++it1) {
-            if(it1->mode_ == LockMode::EXCLUSIVE) {
-               isContainsExclusiveLock = true;
-               break;
-            }
-        }
-        if(isContainsExclusiveLock) {
-            txn_waits_[txn]++; 
-            return false;
-        } else {
-            return true;
-        }
+    else
+    {
+        // A cancelled request: its txn no longer waits for it.
+        if (head->waiting_ == request) head->waiting_ = request->next_;
+        request->owner_->waits_.fetch_sub(1);
+    }
+    if (request->prev_ != NULL)
+        request->prev_->next_ = request->next_;
+    else
+        head->first_ = request->next_;
+    if (request->next_ != NULL)
+        request->next_->prev_ = request->prev_;
+    else
+        head->last_ = request->prev_;
+
+    SmallVector<Txn*, 8> ready;
+    GrantWaiting(head, &ready);
+
+    // Recycle the head of a lock nobody holds or waits for.
+    if (head->first_ == NULL)
+    {
+        partition.lock_table_.erase(head->key_);
+        heads_.Delete(head);
     }
+
+    partition.latch_.Unlock();
+
+    requests_.Delete(request);
+    for (uint32 i = 0; i < ready.size(); i++) on_ready_(ready[i]);
 }
 
-void LockManagerB::Release(Txn* txn, const Key& key)
+void LockManager::GrantWaiting(LockHead* head, SmallVector<Txn*, 8>* ready)
 {
-    
-    //Implement this method!
-    if(lock_table_[key]) {
-        LockMode lock_mode;
-        deque<LockRequest>* queue = lock_table_[key];
-        deque<LockRequest>::iterator it1,it2;
-        bool isA = false;
-        bool isB = false;
-        int ct = 0;
-        for(it1=queue->begin(); it1 != queue->end();it1++) {
-            ct++;
-            if(it1->txn_ == txn) {
-                lock_mode = it1->mode_;
-                lock_table_[key]->erase(it1);
-                break;
-            }
-            if(it1->mode_ == LockMode::EXCLUSIVE && !isA) {
-                isA = true;
-            }
-            if(it1->mode_ == LockMode::SHARED && !isB) {
-                isB = true;
-            }
-        }
-        if(lock_mode == LockMode::SHARED && !isB && !isA) {
-            if(queue->size() > 0) {
-                if(queue->front().mode_ == LockMode::EXCLUSIVE) {
-                    Txn * t = queue->front().txn_;
-                    txn_waits_[t]--;
-                    if(txn_waits_[t] == 0) {
-                        ready_txns_->push_back(t);
-                        txn_waits_.erase(t);
-                    }
-                }
-            }
-        }
-        if(lock_mode == LockMode::EXCLUSIVE && !isA) {
-           int ct1 = 0;
-           for(it2=queue->begin()+ct-1; it2 != queue->end();it2++) {
-                if(it2->mode_ == LockMode::SHARED) {
-                    ct1++;
-                    txn_waits_[it2->txn_]--;
-                    if(txn_waits_[it2->txn_] == 0) {
-                        ready_txns_->push_back(it2->txn_);
-                        txn_waits_.erase(it2->txn_);
-                    }
-                } else {
-                    if(ct1 == 0) {
-                        txn_waits_[it2->txn_]--;
-                        if(txn_waits_[it2->txn_] == 0) {
-                            ready_txns_->push_back(it2->txn_);
-                            txn_waits_.erase(it2->txn_);
-                        }
-                    }
-                    break;
-                }
-            }
-        }
+    while (head->waiting_ != NULL)
+    {
+        LockRequest* request = head->waiting_;
+        if (head->holders_ > 0 && (request->mode_ == EXCLUSIVE || head->first_->mode_ == EXCLUSIVE)) break;
+        request->granted_ = true;
+        head->holders_++;
+        head->waiting_ = request->next_;
+        int waits = request->owner_->waits_.fetch_sub(1);
+        if ((waits & (LockOwner::kWaitsMask | LockOwner::kReported)) == 1)
+            ready->Insert(ready->end(), request->owner_->txn_);
     }
 }
 
-// NOTE: The owners input vector is NOT assumed to be empty.
-LockMode LockManagerB::Status(const Key& key, vector<Txn*>* owners)
+LockMode LockManager::Holders(const Key& key, vector<Txn*>* owners)
 {
-    //
-    // Implement this method!
-     if(lock_table_[key]) {
-        if(lock_table_[key]->size() == 0) {
-            return LockMode::UNLOCKED;
-        } else {
-            owners->clear();
-            deque<LockRequest>* queue = lock_table_[key];
-            if(queue->front().mode_ == LockMode::EXCLUSIVE) {
-                owners->push_back(queue->front().txn_);
-                return LockMode::EXCLUSIVE;
-            } else {
-                deque<LockRequest>::iterator it1;
-                for(it1=queue->begin(); it1 != queue->end();++it1) {
-                    if(it1->mode_ == LockMode::SHARED) {
-                        owners->push_back(it1->txn_);
-                    } else {
-                        break;
-                    }
-                }
-                return LockMode::SHARED;
-            }    
-        }
+    Partition& partition = PartitionOf(key);
+    partition.latch_.Lock();
+
+    owners->clear();
+    LockMode mode = UNLOCKED;
+    unordered_map<Key, LockHead*>::iterator entry = partition.lock_table_.find(key);
+    if (entry != partition.lock_table_.end())
+    {
+        // A head in the table always has a holder.
+        LockHead* head = entry->second;
+        mode           = head->first_->mode_;
+        for (LockRequest* request = head->first_; request != NULL && request->granted_; request = request->next_)
+            owners->push_back(request->owner_->txn_);
     }
+
+    partition.latch_.Unlock();
+    return mode;
+}
+
+LockManagerA::LockManagerA(deque<Txn*>* ready_txns, DeadlockPolicy policy) : LockManager(ready_txns, policy) {}
+
+LockManagerA::LockManagerA(const ReadyCallback& on_ready, DeadlockPolicy policy)
+    : LockManager(on_ready, policy)
+{
+}
+
+bool LockManagerA::WriteLock(Txn* txn, const Key& key) { return Request(txn, key, EXCLUSIVE); }
+
+bool LockManagerA::ReadLock(Txn* txn, const Key& key)
+{
+    // Since Part 1A implements ONLY exclusive locks, calls to ReadLock can
+    // simply use the same logic as 'WriteLock'.
+    return WriteLock(txn, key);
+}
+
+void LockManagerA::Release(Txn* txn, const Key& key) { Remove(txn, key); }
+
+bool LockManagerA::WriteLock(LockOwner* owner, const Key& key) { return Request(owner, key, EXCLUSIVE); }
+
+bool LockManagerA::ReadLock(LockOwner* owner, const Key& key) { return WriteLock(owner, key); }
+
+// NOTE: The owners input vector is NOT assumed to be empty.
+LockMode LockManagerA::Status(const Key& key, vector<Txn*>* owners) { return Holders(key, owners); }
+
+LockManagerB::LockManagerB(deque<Txn*>* ready_txns, DeadlockPolicy policy) : LockManager(ready_txns, policy) {}
+
+LockManagerB::LockManagerB(const ReadyCallback& on_ready, DeadlockPolicy policy)
+    : LockManager(on_ready, policy)
+{
 }
 
+bool LockManagerB::WriteLock(Txn* txn, const Key& key) { return Request(txn, key, EXCLUSIVE); }
+
+bool LockManagerB::ReadLock(Txn* txn, const Key& key) { return Request(txn, key, SHARED); }
+
+void LockManagerB::Release(Txn* txn, const Key& key) { Remove(txn, key); }
+
+bool LockManagerB::WriteLock(LockOwner* owner, const Key& key) { return Request(owner, key, EXCLUSIVE); }
+
+bool LockManagerB::ReadLock(LockOwner* owner, const Key& key) { return Request(owner, key, SHARED); }
+
+// NOTE: The owners input vector is NOT assumed to be empty.
+LockMode LockManagerB::Status(const Key& key, vector<Txn*>* owners) { return Holders(key, owners); }
@@ -3,12 +3,17 @@
 #ifndef _LOCK_MANAGER_H_
 #define _LOCK_MANAGER_H_
 
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <vector>
 
 #include "utils/common.h"
+#include "utils/flat_map.h"
+#include "utils/mutex.h"
+#include "utils/object_pool.h"
 
 using std::map;
 using std::deque;
@@ -16,6 +21,7 @@ using std::vector;
 using std::unordered_map;
 
 class Txn;
+struct LockRequest;
 
 // This interface supports locks being held in both read/shared and
 // write/exclusive modes.
@@ -26,10 +32,136 @@ enum LockMode
     EXCLUSIVE = 2,
 };
 
+// What a lock request does about a conflicting request ahead of it, given
+// the timestamps of their owners (see LockOwner::SetTimestamp()).
+enum DeadlockPolicy
+{
+    ORDERED    = 0,  // Always wait: callers request locks in one global order.
+    WAIT_DIE   = 1,  // An older requester waits; a younger one aborts.
+    WOUND_WAIT = 2,  // An older requester aborts the younger one; a younger one waits.
+};
+
+/// @class LockOwner
+///
+/// A txn's side of the lock table: its lock requests, which it releases
+/// through here without looking them up, and how many of them are blocked.
+/// Owned by the caller (e.g. embedded in the txn), and only used by one
+/// thread at a time: the txn's requests are issued by one thread (one at a
+/// time, or as a batch bracketed by BeginRequests() and EndRequests()) and,
+/// once the txn holds its locks, released by one thread.
+///
+/// Under WAIT_DIE and WOUND_WAIT, the owner may be chosen as a victim to
+/// break a possible deadlock. A victim blocked on a request (or that blocks
+/// later) is reported to the ready callback without getting its lock; it
+/// must then see Aborted(), release everything and start over.
+class LockOwner
+{
+   public:
+    explicit LockOwner(Txn* txn = NULL) : txn_(txn), waits_(0), requests_(NULL), ts_(0) {}
+
+    // True if the owner holds or waits for no lock.
+    bool Empty() const { return requests_ == NULL; }
+
+    // True if the owner was chosen as a victim since it last released its
+    // locks.
+    bool Aborted() const { return (waits_.load() & kAborted) != 0; }
+
+    // Sets the owner's age for deadlock prevention: the smaller, the older.
+    // Set it once per txn, and keep it when the txn restarts after being
+    // chosen as a victim, so that it eventually is the oldest and wins.
+    void SetTimestamp(uint64 ts) { ts_ = ts; }
+
+   private:
+    friend class LockManager;
+
+    // Disallow copying.
+    LockOwner(const LockOwner&);
+    LockOwner& operator=(const LockOwner&);
+
+    // Flags of 'waits_': the owner was chosen as a victim, and it was then
+    // reported to the ready callback (so granting its requests must not
+    // report it again).
+    static const int kAborted   = 1 << 30;
+    static const int kReported  = 1 << 29;
+    static const int kWaitsMask = kReported - 1;
+
+    // Passed to the ready callback.
+    Txn* txn_;
+
+    // Number of blocked requests, and the flags above. Decremented by
+    // whichever thread grants a request; the flags are only set under the
+    // latch of a lock the owner requested.
+    std::atomic<int> waits_;
+
+    // The owner's requests, most recent first.
+    LockRequest* requests_;
+
+    // See SetTimestamp().
+    uint64 ts_;
+};
+
+// The LockManager's lock table tracks all lock requests. For a given key, if
+// the table contains a LockHead, then the item with that key is locked and
+// either:
+//
+//  (a) first request in the head's list specifies the owner if that item is a
+//      request for an EXCLUSIVE lock, or
+//
+//  (b) a SHARED lock is held by all elements of the longest prefix of the
+//      list containing only SHARED lock requests.
+//
+// For example, if the list of "key1" contains
+//
+//    (&Txn1, SHARED), (&Txn2, SHARED), (&Txn3, EXCLUSIVE), (&Txn4, SHARED)
+//
+// then Txn1 and Txn2 currently hold a SHARED lock on the record with key
+// "key1". Only when they BOTH release their locks will Txn3 acquire its
+// exclusive lock on the record. (Note that since Txn4 comes after Txn3, it
+// cannot acquire a lock until after Txn3 has released its lock, so it cannot
+// share the lock with Txn1 and Txn2.)
+//
+// As a second example, if the list of "key1" contains
+//
+//    (&Txn1, EXCLUSIVE), (&Txn2, SHARED), (&Txn3, SHARED), (Txn4, EXCLUSIVE)
+//
+// then Txn1 currently holds an EXCLUSIVE lock on "key1". When Txn1 releases
+// its lock, Txn2 and Txn3 will simultaneously acquire SHARED locks on "key1".
+//
+// Requests are nodes of an intrusive doubly linked list per key, and a head
+// is removed from the table (and recycled) as soon as its list empties.
+struct LockHead
+{
+    Key key_;
+    LockRequest* first_;
+    LockRequest* last_;
+    LockRequest* waiting_;  // First request not granted (NULL if none).
+    int holders_;           // Number of granted requests (a prefix of the list).
+};
+
+struct LockRequest
+{
+    LockOwner* owner_;         // Lock state of the txn requesting the lock.
+    LockMode mode_;            // Specifies whether this is a read or write lock request.
+    bool granted_;             // True once the lock is held.
+    LockHead* head_;           // The lock requested.
+    LockRequest* prev_;        // Neighbours in the head's list.
+    LockRequest* next_;
+    LockRequest* owner_next_;  // Next (older) request of the same owner.
+};
+
 class LockManager
 {
    public:
-    virtual ~LockManager() {}
+    // Called with each txn that was blocked on at least one lock request and
+    // has now acquired all of the locks it requested.
+    typedef std::function<void(Txn*)> ReadyCallback;
+
+    virtual ~LockManager();
+
+    // All methods below may be called concurrently from any number of
+    // threads. Requests for keys in different partitions of the lock table
+    // never contend.
+
     // Attempts to grant a read lock to the specified transaction, enqueueing
     // request in lock table. Returns true if lock is immediately granted, else
     // returns false.
@@ -49,76 +181,123 @@ class LockManager
     // Releases lock held by 'txn' on 'key', or cancels any pending request for
     // a lock on 'key' by 'txn'. If 'txn' held an EXCLUSIVE lock on 'key' (or was
     // the sole holder of a SHARED lock on 'key'), then the next request(s) in the
-    // request queue is granted. If the granted request(s) corresponds to a
-    // transaction that has now acquired ALL of its locks, that transaction is
-    // appended to the 'ready_txns_' queue.
-    //
-    // IMPORTANT NOTE: In order to know WHEN a transaction is ready to run, you
-    // may need to track its lock acquisition progress during the lock request
-    // process.
-    // (Hint: Use 'LockManager::txn_waits_' defined below.)
+    // request queue is granted. Each granted request whose transaction has now
+    // acquired ALL of its locks is reported to the ready callback, from the
+    // calling thread, after the lock table latch is dropped.
     virtual void Release(Txn* txn, const Key& key) = 0;
 
+    // Same as above, for the txn of 'owner', which keeps the handles of its
+    // requests: no per-txn bookkeeping is looked up, and ReleaseAll() drops
+    // each request in constant time.
+    virtual bool ReadLock(LockOwner* owner, const Key& key) = 0;
+    virtual bool WriteLock(LockOwner* owner, const Key& key) = 0;
+
+    // Releases every lock held, and cancels every request pending, by
+    // 'owner'. Also clears its Aborted() flag.
+    void ReleaseAll(LockOwner* owner);
+
+    // Bracket a batch of requests of 'owner': its txn is not reported to the
+    // ready callback while its requests are still being issued. EndRequests()
+    // returns true iff all of them were granted already, in which case the
+    // txn will not be reported at all. ORDERED only.
+    void BeginRequests(LockOwner* owner) { owner->waits_.fetch_add(1); }
+    bool EndRequests(LockOwner* owner) { return owner->waits_.fetch_sub(1) == 1; }
+
     // Sets '*owners' to contain the txn IDs of all txns holding the lock, and
     // returns the current LockMode of the lock: UNLOCKED if it is not currently
     // held, SHARED or EXCLUSIVE if it is, depending on the current state.
     virtual LockMode Status(const Key& key, vector<Txn*>* owners) = 0;
 
    protected:
-    // The LockManager's lock table tracks all lock requests. For a given key, if
-    // 'lock_table_' contains a nonempty deque, then the item with that key is
-    // locked and either:
-    //
-    //  (a) first element in the deque specifies the owner if that item is a
-    //      request for an EXCLUSIVE lock, or
-    //
-    //  (b) a SHARED lock is held by all elements of the longest prefix of the
-    //      deque containing only SHARED lock requests.
-    //
-    // For example, if lock_table_["key1"] points to a deque containing
-    //
-    //    (&Txn1, SHARED), (&Txn2, SHARED), (&Txn3, EXCLUSIVE), (&Txn4, SHARED)
-    //
-    // then Txn1 and Txn2 currently hold a SHARED lock on the record with key
-    // "key1". Only when they BOTH release their locks will Txn3 acquire its
-    // exclusive lock on the record. (Note that since Txn4 comes after Txn3, it
-    // cannot acquire a lock until after Txn3 has released its lock, so it cannot
-    // share the lock with Txn1 and Txn2.)
-    //
-    // As a second example, if lock_table_["key1"] points to a deque containing
-    //
-    //    (&Txn1, EXCLUSIVE), (&Txn2, SHARED), (&Txn3, SHARED), (Txn4, EXCLUSIVE)
-    //
-    // then Txn1 currently holds an EXCLUSIVE lock on "key1". When Txn1 releases
-    // its lock, Txn2 and Txn3 will simultaneously acquire SHARED locks on "key1".
-    struct LockRequest
+    // Appends ready txns to '*ready_txns', which is not synchronized: only
+    // for lock managers used by a single thread.
+    explicit LockManager(deque<Txn*>* ready_txns, DeadlockPolicy policy = ORDERED);
+
+    explicit LockManager(const ReadyCallback& on_ready, DeadlockPolicy policy = ORDERED);
+
+    // Implementation shared by the subclasses: enqueues a 'mode' request,
+    // dequeues a request, and reports a lock's holders. Requests through the
+    // Txn* interface have timestamp 0.
+    bool Request(Txn* txn, const Key& key, LockMode mode);
+    bool Request(LockOwner* owner, const Key& key, LockMode mode);
+    void Remove(Txn* txn, const Key& key);
+    LockMode Holders(const Key& key, vector<Txn*>* owners);
+
+   private:
+    // Number of partitions of the lock table and of 'txn_owners_' (powers
+    // of two).
+    static const int kPartitions  = 1024;
+    static const int kOwnerStripes = 64;
+
+    // A slice of the lock table, guarded by its own latch.
+    struct alignas(CACHE_LINE_SIZE) Partition
     {
-        LockRequest(LockMode m, Txn* t) : txn_(t), mode_(m) {}
-        Txn* txn_;       // Pointer to txn requesting the lock.
-        LockMode mode_;  // Specifies whether this is a read or write lock request.
+        SpinLock latch_;
+        unordered_map<Key, LockHead*> lock_table_;
     };
-    unordered_map<Key, deque<LockRequest>*> lock_table_;
 
-    // Queue of pointers to transactions that:
-    //  (a) were previously blocked on acquiring at least one lock, and
-    //  (b) have now acquired all locks that they have requested.
-    deque<Txn*>* ready_txns_;
+    // A slice of 'txn_owners_'.
+    struct alignas(CACHE_LINE_SIZE) OwnerStripe
+    {
+        SpinLock latch_;
+        unordered_map<Txn*, LockOwner*> owners_;
+    };
+
+    Partition& PartitionOf(const Key& key) { return partitions_[(HashKey(key) >> 32) & (kPartitions - 1)]; }
+
+    OwnerStripe& StripeOf(Txn* txn)
+    {
+        return txn_owners_[(HashKey(reinterpret_cast<uint64>(txn)) >> 32) & (kOwnerStripes - 1)];
+    }
+
+    // Unlinks 'request' (already unlinked from its owner's list) from its
+    // lock, grants whatever that unblocks, and frees it.
+    void Dequeue(LockRequest* request);
+
+    // Grants the waiting requests of (latched) 'head' that are compatible
+    // with its holders, and appends the txns that thereby acquired all
+    // their locks to '*ready'.
+    void GrantWaiting(LockHead* head, SmallVector<Txn*, 8>* ready);
+
+    // Applies 'policy_' to 'request', just queued behind a conflicting
+    // request in its (latched) head, and appends the victims to report to
+    // '*ready'.
+    void PreventDeadlock(LockRequest* request, SmallVector<Txn*, 8>* ready);
+
+    // Chooses 'owner', which has a request in a latched head, as a victim;
+    // appends its txn to '*ready' if it is blocked.
+    void Abort(LockOwner* owner, SmallVector<Txn*, 8>* ready);
+
+    // The lock table, partitioned by key hash.
+    Partition* partitions_;
+
+    // Lock state of the txns using the Txn* interface, striped by txn.
+    // Entries are created by a txn's first request and dropped with its last
+    // one.
+    OwnerStripe* txn_owners_;
+
+    // Storage of the lock table.
+    ObjectPool<LockHead> heads_;
+    ObjectPool<LockRequest> requests_;
+    ObjectPool<LockOwner> owners_;
+
+    ReadyCallback on_ready_;
 
-    // Tracks all txns still waiting on acquiring at least one lock. Entries in
-    // 'txn_waits_' are invalided by any call to Release() with the entry's
-    // txn.
-    unordered_map<Txn*, int> txn_waits_;
+    DeadlockPolicy policy_;
 };
 
 // Version of the LockManager implementing ONLY exclusive locks.
 class LockManagerA : public LockManager
 {
    public:
-    explicit LockManagerA(deque<Txn*>* ready_txns);
+    explicit LockManagerA(deque<Txn*>* ready_txns, DeadlockPolicy policy = ORDERED);
+    explicit LockManagerA(const ReadyCallback& on_ready, DeadlockPolicy policy = ORDERED);
     inline virtual ~LockManagerA() {}
     virtual bool ReadLock(Txn* txn, const Key& key);
     virtual bool WriteLock(Txn* txn, const Key& key);
     virtual void Release(Txn* txn, const Key& key);
+    virtual bool ReadLock(LockOwner* owner, const Key& key);
+    virtual bool WriteLock(LockOwner* owner, const Key& key);
     virtual LockMode Status(const Key& key, vector<Txn*>* owners);
 };
 
@@ -126,12 +305,15 @@ class LockManagerA : public LockManager
 class LockManagerB : public LockManager
 {
    public:
-    explicit LockManagerB(deque<Txn*>* ready_txns);
+    explicit LockManagerB(deque<Txn*>* ready_txns, DeadlockPolicy policy = ORDERED);
+    explicit LockManagerB(const ReadyCallback& on_ready, DeadlockPolicy policy = ORDERED);
     inline virtual ~LockManagerB() {}
     virtual bool ReadLock(Txn* txn, const Key& key);
     virtual bool WriteLock(Txn* txn, const Key& key);
     virtual void Release(Txn* txn, const Key& key);
+    virtual bool ReadLock(LockOwner* owner, const Key& key);
+    virtual bool WriteLock(LockOwner* owner, const Key& key);
     virtual LockMode Status(const Key& key, vector<Txn*>* owners);
 };
 
-#endif  // _LOCK_MANAGER_H_
\ No newline at end of file
+#endif  // _LOCK_MANAGER_H_
@@ -1,5 +1,8 @@
 #include "lock_manager.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
 #include <set>
 #include <string>
 
@@ -187,10 +190,301 @@ TEST(LockManagerB_LocksReleasedOutOfOrder)
     END;
 }
 
+TEST(LockManagerB_OwnerHandles)
+{
+    deque<Txn*> ready_txns;
+    LockManagerB lm(&ready_txns);
+    vector<Txn*> owners;
+
+    Txn* t1 = reinterpret_cast<Txn*>(1);
+    Txn* t2 = reinterpret_cast<Txn*>(2);
+    Txn* t3 = reinterpret_cast<Txn*>(3);
+    LockOwner o1(t1), o2(t2), o3(t3);
+
+    EXPECT_TRUE(lm.WriteLock(&o1, 101));
+    EXPECT_TRUE(lm.ReadLock(&o1, 102));
+    EXPECT_FALSE(lm.ReadLock(&o2, 101));  // Waits for Txn 1.
+    EXPECT_TRUE(lm.ReadLock(&o2, 102));   // Shares with Txn 1.
+    EXPECT_FALSE(lm.WriteLock(&o3, 102));
+
+    // Txn 1 releases everything. Txn 2 gets its last lock; Txn 3 still waits
+    // for Txn 2.
+    lm.ReleaseAll(&o1);
+    EXPECT_TRUE(o1.Empty());
+    EXPECT_EQ(1, ready_txns.size());
+    EXPECT_EQ(t2, ready_txns.at(0));
+    EXPECT_EQ(SHARED, lm.Status(101, &owners));
+    EXPECT_EQ(1, owners.size());
+    EXPECT_EQ(t2, owners[0]);
+    EXPECT_EQ(SHARED, lm.Status(102, &owners));
+    EXPECT_EQ(1, owners.size());
+    EXPECT_EQ(t2, owners[0]);
+
+    lm.ReleaseAll(&o2);
+    EXPECT_EQ(2, ready_txns.size());
+    EXPECT_EQ(t3, ready_txns.at(1));
+    EXPECT_EQ(UNLOCKED, lm.Status(101, &owners));
+    EXPECT_EQ(0, owners.size());
+    EXPECT_EQ(EXCLUSIVE, lm.Status(102, &owners));
+    EXPECT_EQ(t3, owners[0]);
+
+    // Freed locks can be taken again.
+    lm.ReleaseAll(&o3);
+    EXPECT_EQ(UNLOCKED, lm.Status(102, &owners));
+    EXPECT_TRUE(lm.WriteLock(&o1, 102));
+    lm.ReleaseAll(&o1);
+
+    END;
+}
+
+// Shared by the threads of LockManagerB_ConcurrentRequests.
+struct ConcurrentLockArgs
+{
+    LockManager* lm;
+    std::atomic<bool>* ready;        // Per thread: set by the ready callback.
+    std::atomic<int>* writers;       // Per key: number of write lock holders.
+    std::atomic<int>* readers;       // Per key: number of read lock holders.
+    std::atomic<bool>* conflict;     // Set if a key was ever held in conflicting modes.
+    int thread;
+    int rounds;
+    int keys;
+};
+
+static void* LockKeysRepeatedly(void* arg)
+{
+    ConcurrentLockArgs* args = reinterpret_cast<ConcurrentLockArgs*>(arg);
+    Txn* txn                 = reinterpret_cast<Txn*>(args->thread + 1);
+    uint32 x                 = 2654435761u * (args->thread + 1);
+    for (int round = 0; round < args->rounds; round++)
+    {
+        // Lock two keys (the first one in 'write' mode) in key order, so
+        // nobody deadlocks, one at a time, waiting for the ready callback
+        // whenever a request blocks.
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        Key first   = x % (args->keys - 1);
+        Key second  = first + 1 + (x >> 16) % (args->keys - 1 - first);
+        bool write  = (x >> 8) & 1;
+        Key keys[2] = {first, second};
+        for (int i = 0; i < 2; i++)
+        {
+            args->ready[args->thread].store(false);
+            bool granted = (write && i == 0) ? args->lm->WriteLock(txn, keys[i]) : args->lm->ReadLock(txn, keys[i]);
+            while (!granted && !args->ready[args->thread].load()) sched_yield();
+        }
+
+        if (write)
+        {
+            if (args->writers[first].fetch_add(1) != 0 || args->readers[first].load() != 0) args->conflict->store(true);
+            args->writers[first].fetch_sub(1);
+        }
+        else
+        {
+            args->readers[first].fetch_add(1);
+            if (args->writers[first].load() != 0) args->conflict->store(true);
+            args->readers[first].fetch_sub(1);
+        }
+
+        for (int i = 0; i < 2; i++) args->lm->Release(txn, keys[i]);
+    }
+    return NULL;
+}
+
+TEST(LockManagerB_BatchedRequests)
+{
+    deque<Txn*> ready_txns;
+    LockManagerB lm(&ready_txns);
+
+    Txn* t1 = reinterpret_cast<Txn*>(1);
+    Txn* t2 = reinterpret_cast<Txn*>(2);
+    LockOwner o1(t1), o2(t2);
+
+    // Txn 1 gets everything it asks for, so it is not reported.
+    lm.BeginRequests(&o1);
+    EXPECT_TRUE(lm.WriteLock(&o1, 101));
+    EXPECT_TRUE(lm.ReadLock(&o1, 102));
+    EXPECT_TRUE(lm.EndRequests(&o1));
+
+    // Txn 2 waits for 101; Txn 1 releases it before Txn 2 is done asking,
+    // which must not report Txn 2 yet.
+    lm.BeginRequests(&o2);
+    EXPECT_FALSE(lm.WriteLock(&o2, 101));
+    lm.ReleaseAll(&o1);
+    EXPECT_EQ(0, ready_txns.size());
+    EXPECT_TRUE(lm.ReadLock(&o2, 102));
+    EXPECT_TRUE(lm.EndRequests(&o2));
+    EXPECT_EQ(0, ready_txns.size());
+    lm.ReleaseAll(&o2);
+
+    // Txn 2 still waits when done asking: reported once granted.
+    EXPECT_TRUE(lm.WriteLock(&o1, 101));
+    lm.BeginRequests(&o2);
+    EXPECT_FALSE(lm.ReadLock(&o2, 101));
+    EXPECT_FALSE(lm.EndRequests(&o2));
+    EXPECT_EQ(0, ready_txns.size());
+    lm.ReleaseAll(&o1);
+    EXPECT_EQ(1, ready_txns.size());
+    EXPECT_EQ(t2, ready_txns.at(0));
+    lm.ReleaseAll(&o2);
+
+    END;
+}
+
+TEST(LockManagerB_WaitDie)
+{
+    deque<Txn*> ready_txns;
+    LockManagerB lm(&ready_txns, WAIT_DIE);
+    vector<Txn*> owners;
+
+    Txn* t1 = reinterpret_cast<Txn*>(1);
+    Txn* t2 = reinterpret_cast<Txn*>(2);
+    Txn* t3 = reinterpret_cast<Txn*>(3);
+    LockOwner o1(t1), o2(t2), o3(t3);
+    o1.SetTimestamp(1);
+    o2.SetTimestamp(2);
+    o3.SetTimestamp(3);
+
+    // Txn 1 (the oldest) waits for Txn 2; Txn 3 would wait for Txn 2 and
+    // Txn 1, so it dies, and is reported without the lock.
+    EXPECT_TRUE(lm.WriteLock(&o2, 101));
+    EXPECT_FALSE(lm.WriteLock(&o1, 101));
+    EXPECT_FALSE(o1.Aborted());
+    EXPECT_EQ(0, ready_txns.size());
+    EXPECT_FALSE(lm.ReadLock(&o3, 101));
+    EXPECT_TRUE(o3.Aborted());
+    EXPECT_EQ(1, ready_txns.size());
+    EXPECT_EQ(t3, ready_txns.at(0));
+
+    // Shared locks do not conflict.
+    EXPECT_TRUE(lm.ReadLock(&o1, 102));
+    EXPECT_TRUE(lm.ReadLock(&o3, 102));
+
+    // Txn 3 restarts; Txn 1 gets its lock when Txn 2 releases it.
+    lm.ReleaseAll(&o3);
+    EXPECT_FALSE(o3.Aborted());
+    lm.ReleaseAll(&o2);
+    EXPECT_EQ(2, ready_txns.size());
+    EXPECT_EQ(t1, ready_txns.at(1));
+    EXPECT_EQ(EXCLUSIVE, lm.Status(101, &owners));
+    EXPECT_EQ(t1, owners[0]);
+    lm.ReleaseAll(&o1);
+
+    END;
+}
+
+TEST(LockManagerB_WoundWait)
+{
+    deque<Txn*> ready_txns;
+    LockManagerB lm(&ready_txns, WOUND_WAIT);
+    vector<Txn*> owners;
+
+    Txn* t1 = reinterpret_cast<Txn*>(1);
+    Txn* t2 = reinterpret_cast<Txn*>(2);
+    Txn* t3 = reinterpret_cast<Txn*>(3);
+    LockOwner o1(t1), o2(t2), o3(t3);
+    o1.SetTimestamp(1);
+    o2.SetTimestamp(2);
+    o3.SetTimestamp(3);
+
+    // Txn 3 (the youngest) waits for Txn 2.
+    EXPECT_TRUE(lm.WriteLock(&o2, 101));
+    EXPECT_TRUE(lm.WriteLock(&o3, 102));
+    EXPECT_FALSE(lm.WriteLock(&o3, 101));
+    EXPECT_FALSE(o3.Aborted());
+    EXPECT_EQ(0, ready_txns.size());
+
+    // Txn 1 wounds Txn 2, which is running and only notices on its own,
+    // and Txn 3, which is blocked and so reported right away.
+    EXPECT_FALSE(lm.WriteLock(&o1, 101));
+    EXPECT_TRUE(o2.Aborted());
+    EXPECT_TRUE(o3.Aborted());
+    EXPECT_EQ(1, ready_txns.size());
+    EXPECT_EQ(t3, ready_txns.at(0));
+
+    // Granting the lock Txn 3 blocked on does not report it again.
+    lm.ReleaseAll(&o2);
+    EXPECT_EQ(1, ready_txns.size());
+    EXPECT_EQ(EXCLUSIVE, lm.Status(101, &owners));
+    EXPECT_EQ(t3, owners[0]);
+    lm.ReleaseAll(&o3);
+    EXPECT_EQ(2, ready_txns.size());
+    EXPECT_EQ(t1, ready_txns.at(1));
+
+    // A victim that blocks later is reported then.
+    EXPECT_TRUE(lm.WriteLock(&o2, 102));
+    EXPECT_FALSE(lm.WriteLock(&o1, 102));
+    EXPECT_TRUE(o2.Aborted());
+    EXPECT_EQ(2, ready_txns.size());
+    EXPECT_TRUE(lm.WriteLock(&o3, 103));
+    EXPECT_FALSE(lm.WriteLock(&o2, 103));
+    EXPECT_EQ(3, ready_txns.size());
+    EXPECT_EQ(t2, ready_txns.at(2));
+    lm.ReleaseAll(&o2);
+    lm.ReleaseAll(&o3);
+    lm.ReleaseAll(&o1);
+    EXPECT_EQ(4, ready_txns.size());
+    EXPECT_EQ(t1, ready_txns.at(3));
+
+    END;
+}
+
+TEST(LockManagerB_ConcurrentRequests)
+{
+    const int kThreads = 4;
+    const int kRounds  = 5000;
+    const int kKeys    = 8;
+
+    std::atomic<bool> ready[kThreads];
+    std::atomic<int> writers[kKeys];
+    std::atomic<int> readers[kKeys];
+    std::atomic<bool> conflict(false);
+    for (int i = 0; i < kThreads; i++) ready[i].store(false);
+    for (int i = 0; i < kKeys; i++)
+    {
+        writers[i].store(0);
+        readers[i].store(0);
+    }
+    LockManagerB lm([&ready](Txn* txn) { ready[reinterpret_cast<uint64>(txn) - 1].store(true); });
+
+    vector<pthread_t> threads(kThreads);
+    vector<ConcurrentLockArgs> args(kThreads);
+    for (int i = 0; i < kThreads; i++)
+    {
+        args[i].lm       = &lm;
+        args[i].ready    = ready;
+        args[i].writers  = writers;
+        args[i].readers  = readers;
+        args[i].conflict = &conflict;
+        args[i].thread   = i;
+        args[i].rounds   = kRounds;
+        args[i].keys     = kKeys;
+        pthread_create(&threads[i], NULL, LockKeysRepeatedly, &args[i]);
+    }
+    for (int i = 0; i < kThreads; i++) pthread_join(threads[i], NULL);
+
+    // Every thread got through all its rounds, never shared a key with a
+    // writer, and left every lock free.
+    EXPECT_FALSE(conflict.load());
+    vector<Txn*> owners;
+    for (int i = 0; i < kKeys; i++)
+    {
+        EXPECT_EQ(UNLOCKED, lm.Status(i, &owners));
+        EXPECT_EQ(0, owners.size());
+    }
+
+    END;
+}
+
 int main(int argc, char** argv)
 {
     LockManagerA_SimpleLocking();
     LockManagerA_LocksReleasedOutOfOrder();
     LockManagerB_SimpleLocking();
     LockManagerB_LocksReleasedOutOfOrder();
+    LockManagerB_OwnerHandles();
+    LockManagerB_BatchedRequests();
+    LockManagerB_WaitDie();
+    LockManagerB_WoundWait();
+    LockManagerB_ConcurrentRequests();
 }
@@ -1,44 +1,54 @@
 #include "mvcc_storage.h"
-#include <deque>
-// Init the storage
-void MVCCStorage::InitStorage()
-{
-    for (int i = 0; i < 1000000; i++)
-    {
-        Write(i, 0, 0);
-        Mutex* key_mutex = new Mutex();
-        mutexs_[i]       = key_mutex;
-    }
-}
 
-// Free memory.
-MVCCStorage::~MVCCStorage()
+#include <sched.h>
+
+MVCCStorage::MVCCStorage(uint64 capacity)
+    : slots_(capacity, kPartitions * 64, "MVCCStorage"),
+      records_(0),
+      gc_cursor_(0),
+      sweep_chained_(0),
+      sweep_longest_(0),
+      versions_reclaimed_(0),
+      chained_versions_(0),
+      longest_chain_(0)
 {
-    for (auto it = mvcc_data_.begin(); it != mvcc_data_.end(); ++it)
-    {
-        delete it->second;
-    }
+}
 
-    mvcc_data_.clear();
+// Free memory. Chained versions belong to 'pool_', which releases them itself.
+MVCCStorage::~MVCCStorage() {}
 
-    for (auto it = mutexs_.begin(); it != mutexs_.end(); ++it)
+void MVCCStorage::Seed(Slot* slot)
+{
+    Value value;
+    if (ReadImage(slot->key_, &value))
     {
-        delete it->second;
+        slot->latest_.value_       = value;
+        slot->latest_.max_read_id_ = 0;
+        slot->latest_.version_id_  = 0;
+        slot->latest_.next_        = NULL;
+        slot->has_latest_          = 1;
+        records_.fetch_add(1);
     }
+}
 
-    mutexs_.clear();
+MVCCStorage::Slot* MVCCStorage::ExistingSlotFor(Key key)
+{
+    Slot* slot = slots_.Find(key);
+    Value value;
+    if (slot == NULL && ReadImage(key, &value)) slot = SlotFor(key);
+    return slot;
 }
 
-// Lock the key to protect its version_list. Remember to lock the key when you read/update the version_list
+// Lock the key to protect its versions. Remember to lock the key when you check/update the versions
 void MVCCStorage::Lock(Key key)
 {
-    mutexs_[key]->Lock();
+    SlotFor(key)->latch_.Lock();
 }
 
 // Unlock the key.
 void MVCCStorage::Unlock(Key key)
 {
-    mutexs_[key]->Unlock();
+    SlotFor(key)->latch_.Unlock();
 }
 
 // MVCC Read
@@ -50,27 +60,22 @@ bool MVCCStorage::Read(Key key, Value *result, int txn_unique_id)
     // Hint: Iterate the version_lists and return the verion whose write timestamp
     // (version_id) is the largest write timestamp less than or equal to txn_unique_id.
 
-     if (!mvcc_data_.count(key) || (*mvcc_data_[key]).empty()) {
-        return false;
-    } else {
-        deque<Version*>* dq = mvcc_data_[key];
-        Version* v = dq->front();
-        if(txn_unique_id > v->max_read_id_) {
-            *result = v->value_;
-            dq->front()->max_read_id_ = txn_unique_id;
-        } else {
-            for (deque<Version*>::iterator itr = dq->begin(); itr != dq->end(); itr++){
-                Version* version = *itr;
-                if (version->max_read_id_ > txn_unique_id){
-                    break;
-                }  else {
-                    *result = version->value_;
-                }
-            }
+    Slot* slot = ExistingSlotFor(key);
+    if (slot == NULL) return false;
+    bool found = false;
+    slot->latch_.Lock();
+    for (Version* version = &slot->latest_; slot->has_latest_ && version != NULL; version = version->next_)
+    {
+        if (version->version_id_ <= txn_unique_id)
+        {
+            *result = version->value_;
+            if (version->max_read_id_ < txn_unique_id) version->max_read_id_ = txn_unique_id;
+            found = true;
+            break;
         }
-        return true;
     }
-    
+    slot->latch_.Unlock();
+    return found;
 }
 
 // Check whether apply or abort the write
@@ -86,15 +91,8 @@ bool MVCCStorage::CheckWrite(Key key, int txn_unique_id)
     // Note that you don't have to call Lock(key) in this method, just
     // call Lock(key) before you call this method and call Unlock(key) afterward.
 
-     if (!mvcc_data_.count(key) || (*mvcc_data_[key]).empty()) {
-        return true;
-    } else {
-        Version* v =  mvcc_data_[key]->front();
-        if(v->max_read_id_ > txn_unique_id) {
-          return false;
-        }
-        return true;
-    }
+    Slot* slot = SlotFor(key);
+    return !slot->has_latest_ || slot->latest_.max_read_id_ <= txn_unique_id;
 }
 
 
@@ -110,15 +108,8 @@ bool MVCCStorage::CheckWrite1(Key key, int txn_unique_id)
     // Note that you don't have to call Lock(key) in this method, just
     // call Lock(key) before you call this method and call Unlock(key) afterward.
 
-     if (!mvcc_data_.count(key) || (*mvcc_data_[key]).empty()) {
-        return true;
-    } else {
-        Version* v =  mvcc_data_[key]->front();
-        if(v->version_id_ > txn_unique_id) {
-            return false;
-        }
-        return true;
-    }
+    Slot* slot = SlotFor(key);
+    return !slot->has_latest_ || slot->latest_.version_id_ <= txn_unique_id;
 }
 
 // MVCC Write, call this method only if CheckWrite return true.
@@ -128,16 +119,160 @@ void MVCCStorage::Write(Key key, Value value, int txn_unique_id)
     // Implement this method!
 
     // Hint: Insert a new version (malloc a Version and specify its value/version_id/max_read_id)
-    // into the version_lists. Note that InitStorage() also calls this method to init storage.
+    // into the version_lists.
     // Note that you don't have to call Lock(key) in this method, just
     // call Lock(key) before you call this method and call Unlock(key) afterward.
     // Note that the performance would be much better if you organize the versions in decreasing order.
-    Version* version = new Version();
-    version->value_ = value;
-    version->max_read_id_ = txn_unique_id;
-    version->version_id_ = txn_unique_id;
-    if (!mvcc_data_[key]) {
-        mvcc_data_[key] = new std::deque<Version*>;
+    Slot* slot = SlotFor(key);
+    BeginChange(slot);
+    if (slot->has_latest_)
+    {
+        // Demote the current newest version to the head of the chain.
+        Version* older       = pool_.New();
+        *older               = slot->latest_;
+        slot->latest_.next_  = older;
+        slots_.Mark(slot);
+    }
+    else
+    {
+        slot->latest_.next_ = NULL;
+        slot->has_latest_   = 1;
+        records_.fetch_add(1);
+    }
+    slot->latest_.value_       = value;
+    slot->latest_.max_read_id_ = txn_unique_id;
+    slot->latest_.version_id_  = txn_unique_id;
+    EndChange(slot);
+}
+
+bool MVCCStorage::SnapshotRead(Key key, Value* result, int ts)
+{
+    // A key without a slot was never written: it only has its image version.
+    Slot* slot = slots_.Find(key);
+    if (slot == NULL) return ReadImage(key, result);
+    Value value;
+    bool found;
+    Version* older;
+    while (true)
+    {
+        uint32 seq = slot->seq_.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        // The fields may change under us; they are only used if 'seq_' shows
+        // they didn't.
+        found = __atomic_load_n(&slot->has_latest_, __ATOMIC_RELAXED) &&
+                __atomic_load_n(&slot->latest_.version_id_, __ATOMIC_RELAXED) <= ts;
+        value = __atomic_load_n(&slot->latest_.value_, __ATOMIC_RELAXED);
+        older = __atomic_load_n(&slot->latest_.next_, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq_.load(std::memory_order_relaxed) == seq) break;
     }
-    mvcc_data_[key]->push_front(version);
-}
\ No newline at end of file
+
+    // A chained version only changes when the collector cuts the chain after
+    // it, and it keeps every version a reader at 'ts' can reach (snapshots
+    // are at or above the watermark it trims at).
+    for (Version* version = older; !found && version != NULL;
+         version = __atomic_load_n(&version->next_, __ATOMIC_ACQUIRE))
+    {
+        if (version->version_id_ <= ts)
+        {
+            value = version->value_;
+            found = true;
+            break;
+        }
+    }
+    if (found) *result = value;
+    return found;
+}
+
+void MVCCStorage::NewerVersions(Key key, int ts, vector<int>* version_ids)
+{
+    // A key without a slot only has its image version, which is never newer.
+    Slot* slot = slots_.Find(key);
+    if (slot == NULL) return;
+    slot->latch_.Lock();
+    for (Version* version = &slot->latest_; slot->has_latest_ && version != NULL && version->version_id_ > ts;
+         version = version->next_)
+        version_ids->push_back(version->version_id_);
+    slot->latch_.Unlock();
+}
+
+void MVCCStorage::CollectGarbage(int low_watermark, int num_partitions)
+{
+    uint64 reclaimed = 0;
+    for (int n = 0; n < num_partitions; n++)
+    {
+        for (int level = 0; level < SlotTable<Slot>::kMaxLevels && slots_.Slots(level) != NULL; level++)
+        {
+            // Only slots whose bit is set have anything to trim.
+            Slot* slots                = slots_.Slots(level);
+            std::atomic<uint64>* marks = slots_.Marks(level);
+            uint64 words               = slots_.Capacity(level) / 64 / kPartitions;
+            for (uint64 w = gc_cursor_ * words; w < (gc_cursor_ + 1) * words; w++)
+            {
+                uint64 bits = marks[w].load(std::memory_order_relaxed);
+                while (bits != 0)
+                {
+                    uint64 index = w * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+
+                    // The latch is held only for the trim itself, so a
+                    // transaction waits on the collector for at most that long.
+                    Slot* slot = &slots[index];
+                    slot->latch_.Lock();
+                    // Versions are ordered newest first: everything after the
+                    // first version visible at 'low_watermark' is unreachable.
+                    Version* visible = &slot->latest_;
+                    uint64 length    = 1;
+                    while (visible->next_ != NULL && visible->version_id_ > low_watermark)
+                    {
+                        visible = visible->next_;
+                        length++;
+                    }
+                    Version* garbage = visible->next_;
+                    if (visible == &slot->latest_) BeginChange(slot);
+                    __atomic_store_n(&visible->next_, (Version*)NULL, __ATOMIC_RELEASE);
+                    if (visible == &slot->latest_) EndChange(slot);
+                    if (slot->latest_.next_ == NULL) marks[w].fetch_and(~(1ULL << (index % 64)));
+                    slot->latch_.Unlock();
+
+                    while (garbage != NULL)
+                    {
+                        Version* next = garbage->next_;
+                        pool_.Delete(garbage);
+                        garbage = next;
+                        reclaimed++;
+                    }
+                    sweep_chained_ += length - 1;
+                    if (length > sweep_longest_) sweep_longest_ = length;
+                }
+            }
+        }
+
+        if (++gc_cursor_ == kPartitions)
+        {
+            // Sweep complete: publish its totals and start over.
+            chained_versions_.store(sweep_chained_);
+            longest_chain_.store(sweep_longest_);
+            gc_cursor_     = 0;
+            sweep_chained_ = 0;
+            sweep_longest_ = 0;
+        }
+    }
+    versions_reclaimed_.fetch_add(reclaimed);
+}
+
+GCStats MVCCStorage::Stats() const
+{
+    GCStats stats;
+    stats.versions_reclaimed = versions_reclaimed_.load();
+    stats.version_lists      = records_.load();
+    stats.live_versions      = stats.version_lists + chained_versions_.load();
+    // Slots without a chain hold exactly one version.
+    stats.longest_chain = longest_chain_.load();
+    if (stats.longest_chain == 0 && stats.version_lists > 0) stats.longest_chain = 1;
+    return stats;
+}
@@ -1,7 +1,12 @@
 #ifndef _MVCC_STORAGE_H_
 #define _MVCC_STORAGE_H_
 
+#include <atomic>
+
+#include "slot_table.h"
 #include "storage.h"
+#include "utils/mutex.h"
+#include "utils/object_pool.h"
 
 // MVCC 'version' structure
 struct Version
@@ -9,16 +14,35 @@ struct Version
     Value value_;      // The value of this version
     int max_read_id_;  // Largest timestamp of a transaction that read the version
     int version_id_;   // Timestamp of the transaction that created(wrote) the version
+    Version* next_;    // Next older version of the same key (NULL if none)
 };
 
 
-// MVCC storage
+// Garbage collection counters of an MVCCStorage. The chain figures are
+// measured by the collector itself, so they lag by up to one full sweep.
+struct GCStats
+{
+    uint64 versions_reclaimed;  // Versions freed since the storage was created
+    uint64 live_versions;       // Versions stored, as of the last full sweep
+    uint64 version_lists;       // Keys with at least one version
+    uint64 longest_chain;       // Most versions of one key seen in the last full sweep
+};
+
+// MVCC storage. Every key owns one cache-line-sized slot in a SlotTable,
+// holding the key's latch and its newest version inline. Older versions hang
+// off the newest one as a singly linked chain (newest first) of
+// pool-allocated Versions. Locking a key and reading or checking its latest
+// version, by far the common case, touch one cache line. Only keys that are
+// written, or read with a timestamp, ever get a slot: reading a key that has
+// none falls back to the attached image.
 class MVCCStorage : public Storage
 {
    public:
     // If there exists a record for the specified key, sets '*result' equal to
     // the value associated with the key and returns true, else returns false;
     // The third parameter is the txn_unique_id(txn timestamp), which is used for MVCC.
+    // Latches the key itself (it records the read in max_read_id_), so don't
+    // call it while holding Lock(key).
     virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
 
     // Inserts a new version with key and value
@@ -28,10 +52,9 @@ class MVCCStorage : public Storage
     // Returns the timestamp at which the record with the specified key was last
     // updated (returns 0 if the record has never been updated). This is used for OCC.
     virtual double Timestamp(Key key) { return 0; }
-    // Init storage
-    virtual void InitStorage();
 
-    // Lock the version_list of key
+    // Lock the version_list of key, before checking and writing it. This
+    // gives the key a slot if it has none yet.
     virtual void Lock(Key key);
 
     // Unlock the version_list of key
@@ -40,23 +63,104 @@ class MVCCStorage : public Storage
     // Check whether apply or abort the write
     virtual bool CheckWrite(Key key, int txn_unique_id);
 
+    // Sets '*result' to the value of the newest version of 'key' with
+    // version_id_ <= 'ts' and returns true, or returns false if there is none.
+    // Takes no latch and writes nothing (max_read_id_ is left alone), so it is
+    // only meaningful for a 'ts' no writer can still install versions below.
+    bool SnapshotRead(Key key, Value* result, int ts);
+
+    // Appends the version_id_ of every version of 'key' newer than 'ts' to
+    // '*version_ids', newest first. Latches the key itself.
+    void NewerVersions(Key key, int ts, vector<int>* version_ids);
+
 
      virtual bool CheckWrite1(Key key, int txn_unique_id);
 
     //virtual void reupdate_read(Key key, int txn_unique_id,int previous_tmp);
 
+    // Reclaims versions that can no longer be read, given that every active
+    // and future transaction has timestamp >= 'low_watermark': of the versions
+    // with version_id_ <= low_watermark only the newest is kept. Every level
+    // of the slot table is collected in kPartitions ranges; each call visits
+    // 'num_partitions' of them, resuming where the previous call stopped, so
+    // the work can be spread over many short calls. Must only be called by one
+    // thread at a time.
+    void CollectGarbage(int low_watermark, int num_partitions);
+
+    GCStats Stats() const;
+
+    static const int kPartitions = 256;
+
+    // Number of distinct keys the default-constructed storage holds before
+    // its table has to grow.
+    static const uint64 kDefaultCapacity = 1 << 21;
+
+    // 'capacity' is rounded up to a power of two (and at least
+    // kPartitions * 64). The table is reserved up front but mapped lazily, so
+    // only slots that are actually used cost memory, and grows past
+    // 'capacity' as needed.
+    explicit MVCCStorage(uint64 capacity = kDefaultCapacity);
     virtual ~MVCCStorage();
 
    private:
     friend class TxnProcessor;
 
-    // Storage for MVCC, each key has a linklist of versions
-    unordered_map<Key, deque<Version*>*> mvcc_data_;
-
-    
-
-    // Mutexs for each key
-    unordered_map<Key, Mutex*> mutexs_;
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        SpinLock latch_;             // Guards the versions (see Lock())
+        std::atomic<uint32> state_;  // See SlotTable
+        std::atomic<uint32> seq_;    // Odd while 'latest_' is being changed (see SnapshotRead())
+        Key key_;
+        Version latest_;             // Newest version, valid iff 'has_latest_'
+        uint32 has_latest_;
+    };
+    static_assert(sizeof(Slot) == CACHE_LINE_SIZE, "An MVCC slot must fill exactly one cache line");
+
+    // Returns the slot of 'key', claiming one if it has none. A new slot is
+    // seeded with the key's value from the attached image (if any) as version
+    // 0.
+    inline Slot* SlotFor(Key key)
+    {
+        return slots_.FindOrClaim(key, [this](Slot* slot) { this->Seed(slot); });
+    }
+    void Seed(Slot* slot);
+
+    // Returns the slot of 'key' if the key has any version, else NULL. Only
+    // claims a slot for a key that is still just in the image.
+    Slot* ExistingSlotFor(Key key);
+
+    // Bracket every change to a (latched) slot's 'latest_', so SnapshotRead()
+    // can detect torn reads.
+    static inline void BeginChange(Slot* slot)
+    {
+        slot->seq_.store(slot->seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    static inline void EndChange(Slot* slot)
+    {
+        slot->seq_.store(slot->seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // A slot's mark bit is set while its newest version has older ones, so
+    // the collector only has to visit slots with chains.
+    SlotTable<Slot> slots_;
+
+    // Allocator for all versions but the inline ones.
+    ObjectPool<Version> pool_;
+
+    // Slots holding at least one version.
+    std::atomic<uint64> records_;
+
+    // Collector state (only touched by the thread calling CollectGarbage()):
+    // the next partition to visit and the totals of the sweep in progress.
+    int gc_cursor_;
+    uint64 sweep_chained_;
+    uint64 sweep_longest_;
+
+    // Published counters, readable from any thread.
+    std::atomic<uint64> versions_reclaimed_;
+    std::atomic<uint64> chained_versions_;
+    std::atomic<uint64> longest_chain_;
 };
 
 #endif  // _MVCC_STORAGE_H_
@@ -0,0 +1,72 @@
+#include "record_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum load factor is kMaxLoadNum / kMaxLoadDen.
+static const uint64 kMaxLoadNum  = 3;
+static const uint64 kMaxLoadDen  = 4;
+static const uint64 kMinCapacity = 16;
+
+// Returns the smallest power-of-two capacity that holds 'size' records.
+static uint64 CapacityFor(uint64 size)
+{
+    uint64 capacity = kMinCapacity;
+    while (capacity * kMaxLoadNum / kMaxLoadDen < size) capacity *= 2;
+    return capacity;
+}
+
+RecordTable::RecordTable(uint64 expected_size) : slots_(NULL), capacity_(0), mask_(0), size_(0), shift_(64)
+{
+    Rehash(CapacityFor(expected_size));
+}
+
+RecordTable::~RecordTable() { free(slots_); }
+
+Record* RecordTable::Insert(Key key)
+{
+    Record* record = Find(key);
+    if (record != NULL) return record;
+
+    if ((size_ + 1) * kMaxLoadDen > capacity_ * kMaxLoadNum) Rehash(capacity_ * 2);
+
+    uint64 i = HashKey(key) >> shift_;
+    while (slots_[i].occupied_) i = (i + 1) & mask_;
+    record            = &slots_[i];
+    record->key_      = key;
+    record->occupied_ = 1;
+    size_++;
+    return record;
+}
+
+void RecordTable::Reserve(uint64 size)
+{
+    uint64 capacity = CapacityFor(size);
+    if (capacity > capacity_) Rehash(capacity);
+}
+
+void RecordTable::Rehash(uint64 capacity)
+{
+    Record* old_slots   = slots_;
+    uint64 old_capacity = capacity_;
+
+    void* mem;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, capacity * sizeof(Record)) != 0)
+        DIE("Failed to allocate record table of " << capacity << " slots.");
+    memset(mem, 0, capacity * sizeof(Record));
+
+    slots_    = static_cast<Record*>(mem);
+    capacity_ = capacity;
+    mask_     = capacity - 1;
+    shift_    = 64;
+    for (uint64 c = capacity; c > 1; c >>= 1) shift_--;
+
+    for (uint64 j = 0; j < old_capacity; j++)
+    {
+        if (!old_slots[j].occupied_) continue;
+        uint64 i = HashKey(old_slots[j].key_) >> shift_;
+        while (slots_[i].occupied_) i = (i + 1) & mask_;
+        slots_[i] = old_slots[j];
+    }
+    free(old_slots);
+}
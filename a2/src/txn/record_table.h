@@ -0,0 +1,73 @@
+#ifndef _RECORD_TABLE_H_
+#define _RECORD_TABLE_H_
+
+#include "utils/common.h"
+
+// A single-version record. Everything a read plus OCC validation needs lives
+// in one 32-byte slot, and slots never straddle a cache line.
+struct Record
+{
+    Key key_;
+    Value value_;
+    double timestamp_;       // Time at which the record was last written
+    int32 committed_index_;  // unique_id_ of the txn that last wrote the record
+    uint32 occupied_;        // Nonzero iff this slot holds a record
+};
+static_assert(sizeof(Record) == 32, "Record slots must pack evenly into cache lines");
+
+/// @class RecordTable
+///
+/// Open-addressing (linear probing) hash table from Key to Record, used as the
+/// backing store of the single-version Storage engines. Records are stored
+/// inline in one flat, cache-line-aligned array, so a lookup is usually a
+/// single cache miss instead of a bucket + node walk per std::unordered_map.
+///
+/// Records are never erased. Insert() may grow the table, which invalidates
+/// all previously returned Record pointers. Not thread-safe.
+class RecordTable
+{
+   public:
+    // Creates a table able to hold 'expected_size' records without growing.
+    explicit RecordTable(uint64 expected_size = 0);
+    ~RecordTable();
+
+    // Returns the record for 'key', or NULL if there is none.
+    inline Record* Find(Key key)
+    {
+        for (uint64 i = HashKey(key) >> shift_;; i = (i + 1) & mask_)
+        {
+            Record* slot = &slots_[i];
+            if (!slot->occupied_) return NULL;
+            if (slot->key_ == key) return slot;
+        }
+    }
+
+    // Returns the record for 'key', inserting a zeroed one if there is none.
+    Record* Insert(Key key);
+
+    // Grows the table (if needed) so that it can hold 'size' records without
+    // further rehashing.
+    void Reserve(uint64 size);
+
+    // Returns the number of records in the table.
+    uint64 Size() const { return size_; }
+
+   private:
+    // Disallow copying; the table owns its slot array.
+    RecordTable(const RecordTable&);
+    RecordTable& operator=(const RecordTable&);
+
+    // Reallocates the slot array with 'capacity' (a power of two) slots and
+    // reinserts every record.
+    void Rehash(uint64 capacity);
+
+    Record* slots_;
+    uint64 capacity_;
+    uint64 mask_;
+    uint64 size_;
+
+    // Right shift applied to HashKey(key) to get the home slot.
+    int shift_;
+};
+
+#endif  // _RECORD_TABLE_H_
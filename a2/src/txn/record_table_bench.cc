@@ -0,0 +1,92 @@
+// Microbenchmark comparing the single-version record layout used by Storage
+// before RecordTable (three std::unordered_maps: values, timestamps and commit
+// indexes) against RecordTable, at the 1M-key size InitStorage() creates.
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "record_table.h"
+
+using std::cout;
+using std::endl;
+using std::unordered_map;
+using std::vector;
+
+static const int kKeys    = 1000000;
+static const int kLookups = 10000000;
+
+// The pre-RecordTable Storage layout.
+struct MapStorage
+{
+    unordered_map<Key, Value> data_;
+    unordered_map<Key, double> timestamps_;
+    unordered_map<Key, int> committed_indexs_;
+};
+
+int main(int argc, char** argv)
+{
+    // Same random key sequence for both layouts.
+    vector<Key> keys(kLookups);
+    for (int i = 0; i < kLookups; i++) keys[i] = rand() % kKeys;
+
+    double start;
+    uint64 checksum = 0;
+
+    // Build + Read/Timestamp (one read plus OCC validation) on the maps.
+    MapStorage* maps = new MapStorage();
+    start            = GetTime();
+    for (int i = 0; i < kKeys; i++)
+    {
+        maps->data_[i]             = 0;
+        maps->timestamps_[i]       = start;
+        maps->committed_indexs_[i] = 0;
+    }
+    double map_build = GetTime() - start;
+
+    start = GetTime();
+    for (int i = 0; i < kLookups; i++)
+    {
+        Key key = keys[i];
+        if (maps->data_.count(key)) checksum += maps->data_[key];
+        if (maps->timestamps_.count(key)) checksum += maps->timestamps_[key] > 0;
+    }
+    double map_lookup = GetTime() - start;
+
+    start = GetTime();
+    delete maps;
+    double map_destroy = GetTime() - start;
+
+    // Same operations on RecordTable.
+    start              = GetTime();
+    RecordTable* table = new RecordTable(kKeys);
+    for (int i = 0; i < kKeys; i++)
+    {
+        Record* record           = table->Insert(i);
+        record->value_           = 0;
+        record->timestamp_       = start;
+        record->committed_index_ = 0;
+    }
+    double table_build = GetTime() - start;
+
+    start = GetTime();
+    for (int i = 0; i < kLookups; i++)
+    {
+        Record* record = table->Find(keys[i]);
+        if (record != NULL) checksum += record->value_ + (record->timestamp_ > 0);
+    }
+    double table_lookup = GetTime() - start;
+
+    start = GetTime();
+    delete table;
+    double table_destroy = GetTime() - start;
+
+    cout << "\t\t\tbuild (ms)\tread+validate (ns/op)\tdestroy (ms)" << endl;
+    cout << "unordered_map x3\t" << map_build * 1e3 << "\t\t" << map_lookup * 1e9 / kLookups << "\t\t\t"
+         << map_destroy * 1e3 << endl;
+    cout << "RecordTable\t\t" << table_build * 1e3 << "\t\t" << table_lookup * 1e9 / kLookups << "\t\t\t"
+         << table_destroy * 1e3 << endl;
+
+    // Keep the lookups from being optimized away.
+    return checksum == 42 ? 1 : 0;
+}
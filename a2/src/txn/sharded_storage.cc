@@ -0,0 +1,47 @@
+#include "sharded_storage.h"
+
+ShardedStorage::ShardedStorage(int num_shards)
+{
+    // Round up to a power of two.
+    num_shards_ = 1;
+    while (num_shards_ < num_shards) num_shards_ *= 2;
+    shard_mask_ = num_shards_ - 1;
+
+    shards_ = NewCacheAlignedArray<Shard>(num_shards_);
+}
+
+ShardedStorage::~ShardedStorage() { DeleteCacheAlignedArray(shards_, num_shards_); }
+
+bool ShardedStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    Shard& shard = ShardFor(key);
+    shard.latch_.Lock();
+    Record* record = shard.records_.Find(key);
+    bool found     = record != NULL;
+    if (found) *result = record->value_;
+    shard.latch_.Unlock();
+    return found || ReadImage(key, result);
+}
+
+void ShardedStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    Shard& shard = ShardFor(key);
+    shard.latch_.Lock();
+    // The timestamp is taken under the latch so that a reader can never observe
+    // the new value paired with a timestamp older than its own read.
+    Record* record           = shard.records_.Insert(key);
+    record->value_           = value;
+    record->timestamp_       = GetTime();
+    record->committed_index_ = txn_unique_id;
+    shard.latch_.Unlock();
+}
+
+double ShardedStorage::Timestamp(Key key)
+{
+    Shard& shard = ShardFor(key);
+    shard.latch_.Lock();
+    Record* record   = shard.records_.Find(key);
+    double timestamp = record == NULL ? 0 : record->timestamp_;
+    shard.latch_.Unlock();
+    return timestamp;
+}
@@ -0,0 +1,45 @@
+#ifndef _SHARDED_STORAGE_H_
+#define _SHARDED_STORAGE_H_
+
+#include "record_table.h"
+#include "storage.h"
+#include "utils/mutex.h"
+
+// Thread-safe single-version storage. The key space is split into a fixed
+// number of partitions ("shards") selected by hashing the key. Each shard owns
+// its own latch and record table and sits on its own cache line(s), so worker
+// threads committing to disjoint keys almost never touch the same latch.
+class ShardedStorage : public Storage
+{
+   public:
+    // 'num_shards' is rounded up to a power of two.
+    explicit ShardedStorage(int num_shards = kDefaultShards);
+    virtual ~ShardedStorage();
+
+    // Same semantics as Storage::Read/Write/Timestamp, but safe to call from
+    // any number of threads concurrently.
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key);
+
+    static const int kDefaultShards = 256;
+
+   private:
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        Mutex latch_;
+        RecordTable records_;
+    };
+
+    // Returns the shard responsible for 'key'. The shard is picked from the
+    // bits of the hash just above its low half: each shard's RecordTable
+    // indexes by the top bits, which stay independent of them.
+    inline Shard& ShardFor(Key key) { return shards_[(HashKey(key) >> 32) & shard_mask_]; }
+
+    // Cache-line-aligned array of 'num_shards_' shards.
+    Shard* shards_;
+    int num_shards_;
+    uint64 shard_mask_;
+};
+
+#endif  // _SHARDED_STORAGE_H_
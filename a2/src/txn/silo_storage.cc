@@ -0,0 +1,78 @@
+#include "silo_storage.h"
+
+#include <sched.h>
+
+// Spins before a waiter on a locked record yields the CPU.
+#define SILO_SPINS_BEFORE_YIELD 64
+
+SiloStorage::SiloStorage(uint64 capacity) : records_(capacity, 1024, "SiloStorage") {}
+
+SiloStorage::~SiloStorage() {}
+
+SiloStorage::Record* SiloStorage::RecordFor(Key key)
+{
+    return records_.FindOrClaim(key, [this](Record* record) { this->Seed(record); });
+}
+
+void SiloStorage::Seed(Record* record)
+{
+    if (ReadImage(record->key_, &record->value_)) record->tid_.store(kPresentBit, std::memory_order_relaxed);
+}
+
+bool SiloStorage::StableRead(Record* record, Value* result, uint64* tid)
+{
+    int spins = 0;
+    while (true)
+    {
+        uint64 before = record->tid_.load(std::memory_order_acquire);
+        if (before & kLockBit)
+        {
+            if (++spins > SILO_SPINS_BEFORE_YIELD) sched_yield();
+            continue;
+        }
+        // The value may change under us; it is only used if the TID shows it
+        // didn't.
+        Value value = __atomic_load_n(&record->value_, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record->tid_.load(std::memory_order_relaxed) == before)
+        {
+            *tid = before;
+            if (before & kPresentBit) *result = value;
+            return before & kPresentBit;
+        }
+    }
+}
+
+void SiloStorage::Lock(Record* record)
+{
+    int spins = 0;
+    while (true)
+    {
+        uint64 tid = record->tid_.load(std::memory_order_relaxed);
+        if (!(tid & kLockBit) && record->tid_.compare_exchange_weak(tid, tid | kLockBit, std::memory_order_acquire))
+            return;
+        if (++spins > SILO_SPINS_BEFORE_YIELD) sched_yield();
+    }
+}
+
+void SiloStorage::Install(Record* record, Value value, uint64 tid)
+{
+    __atomic_store_n(&record->value_, value, __ATOMIC_RELAXED);
+    record->tid_.store((tid & ~kStatusBits) | kPresentBit, std::memory_order_release);
+}
+
+bool SiloStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    // A key without a record was never written: it only has its image value.
+    Record* record = records_.Find(key);
+    if (record == NULL) return ReadImage(key, result);
+    uint64 tid;
+    return StableRead(record, result, &tid);
+}
+
+void SiloStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    Record* record = RecordFor(key);
+    Lock(record);
+    Install(record, value, record->tid_.load(std::memory_order_relaxed) + kSequenceUnit);
+}
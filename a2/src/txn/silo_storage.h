@@ -0,0 +1,81 @@
+#ifndef _SILO_STORAGE_H_
+#define _SILO_STORAGE_H_
+
+#include <atomic>
+
+#include "slot_table.h"
+#include "storage.h"
+
+// Single-version storage for Silo-style OCC. Every key owns one cache-line
+// sized record in a SlotTable (like MVCCStorage's slots), holding its value
+// and a TID word:
+//
+//    bit 0       lock bit, held while the record is being committed
+//    bit 1       set iff the record has a value
+//    bits 2..31  sequence number within the epoch
+//    bits 32..63 epoch
+//
+// TIDs (the word without the lock bit) only ever grow, so a reader can tell
+// whether a record changed since it was read by comparing TIDs.
+class SiloStorage : public Storage
+{
+   public:
+    struct alignas(CACHE_LINE_SIZE) Record
+    {
+        std::atomic<uint64> tid_;
+        Value value_;
+        std::atomic<uint32> state_;  // See SlotTable
+        Key key_;
+    };
+
+    static const uint64 kLockBit    = 1;
+    static const uint64 kPresentBit = 2;
+    static const uint64 kStatusBits = kLockBit | kPresentBit;
+
+    // Smallest TID increment, and TID of the first commit of 'epoch'.
+    static const uint64 kSequenceUnit = 4;
+    static inline uint64 EpochTID(uint64 epoch) { return epoch << 32; }
+    static inline uint64 Epoch(uint64 tid) { return tid >> 32; }
+
+    // Number of distinct keys the default-constructed storage holds before
+    // its table has to grow.
+    static const uint64 kDefaultCapacity = 1 << 21;
+
+    // 'capacity' is rounded up to a power of two. The table is reserved up
+    // front but mapped lazily, so only records that are used cost memory, and
+    // grows past 'capacity' as needed.
+    explicit SiloStorage(uint64 capacity = kDefaultCapacity);
+    virtual ~SiloStorage();
+
+    // Returns the record of 'key', creating it on first access (seeded from
+    // the attached image, with TID 0).
+    Record* RecordFor(Key key);
+
+    // Sets '*tid' to the record's TID and, if the record has a value, sets
+    // '*result' to it, such that the two belong together. Returns true iff the
+    // record has a value. Waits while the record is locked.
+    static bool StableRead(Record* record, Value* result, uint64* tid);
+
+    // Spins until it holds the record's lock bit.
+    static void Lock(Record* record);
+
+    // Sets the value of a record locked by the caller, stamps it with 'tid'
+    // and releases the lock.
+    static void Install(Record* record, Value value, uint64 tid);
+
+    // Releases the lock of 'record' without changing it.
+    static void Unlock(Record* record) { record->tid_.fetch_and(~kLockBit, std::memory_order_release); }
+
+    // Non-transactional access (Write() stamps the record with the next
+    // sequence number of its TID). Read() never creates a record.
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key) { return 0; }
+
+   private:
+    void Seed(Record* record);
+
+    SlotTable<Record> records_;
+};
+
+#endif  // _SILO_STORAGE_H_
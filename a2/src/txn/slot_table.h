@@ -0,0 +1,194 @@
+#ifndef _SLOT_TABLE_H_
+#define _SLOT_TABLE_H_
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <atomic>
+
+#include "utils/common.h"
+
+// Concurrent open-addressing table of per-key slots, shared by the storages
+// that keep one fixed-address slot per key (MVCCStorage, SiloStorage, ...).
+//
+// 'Slot' is any struct with a 'std::atomic<uint32> state_' and a 'Key key_'
+// member for which all-zero bytes are a valid, unused slot. Slots are never
+// moved or freed, so a pointer to one stays valid for the table's lifetime,
+// and lookups take no lock.
+//
+// The table is a series of levels, each twice the size of the one before and
+// reserved (but mapped lazily) only once it is needed. A key is looked for in
+// the first kMaxProbes slots from its home slot in each level in turn, and
+// claims the first empty one it finds. Only when that window is full in every
+// level does a new level get added, so the table grows instead of failing.
+// Since occupied slots stay occupied, all threads agree on which level a key
+// belongs to without any coordination beyond the claim itself.
+//
+// Every slot also has a mark bit, for the owner to flag slots that need
+// attention (e.g. from a garbage collector) without having to visit them all.
+template <typename Slot>
+class SlotTable
+{
+   public:
+    enum SlotState
+    {
+        EMPTY   = 0,  // Unused
+        CLAIMED = 1,  // Being initialized by the thread that claimed it
+        READY   = 2,  // Holds 'key_'
+    };
+
+    // Slots probed per level before moving on to the next one.
+    static const uint64 kMaxProbes = 64;
+    static const int kMaxLevels    = 16;
+
+    // The first level has 'capacity' slots, rounded up to a power of two and
+    // at least 'min_capacity' (itself a power of two, >= kMaxProbes). 'name'
+    // is only used in error messages.
+    SlotTable(uint64 capacity, uint64 min_capacity, const char* name) : name_(name)
+    {
+        base_  = min_capacity;
+        shift_ = 64 - __builtin_ctzll(min_capacity);
+        while (base_ < capacity)
+        {
+            base_ <<= 1;
+            shift_--;
+        }
+        for (int level = 0; level < kMaxLevels; level++) levels_[level].store(NULL);
+        levels_[0].store(MapLevel(0));
+    }
+
+    ~SlotTable()
+    {
+        for (int level = 0; level < kMaxLevels; level++)
+        {
+            Slot* slots = levels_[level].load();
+            if (slots != NULL) munmap(slots, LevelBytes(level));
+        }
+    }
+
+    // Returns the slot of 'key', or NULL if it has none. Never claims a slot.
+    inline Slot* Find(Key key) { return Probe(key, false, NoInit()); }
+
+    // Returns the slot of 'key', claiming one if it has none. A new slot
+    // already holds 'key_' when it is passed to 'init(slot)', which must fill
+    // in the rest before the slot can be seen by any other thread.
+    template <typename Init>
+    inline Slot* FindOrClaim(Key key, Init init)
+    {
+        return Probe(key, true, init);
+    }
+
+    // Levels are numbered 0, 1, ...; Slots(level) is NULL for one that has
+    // not been added yet.
+    inline uint64 Capacity(int level) const { return base_ << level; }
+    inline Slot* Slots(int level) const { return levels_[level].load(std::memory_order_acquire); }
+
+    // Mark bits of an existing level's slots, Capacity(level) / 64 words:
+    // slot i's is bit i % 64 of word i / 64.
+    inline std::atomic<uint64>* Marks(int level) const
+    {
+        return reinterpret_cast<std::atomic<uint64>*>(Slots(level) + Capacity(level));
+    }
+
+    // Sets the mark bit of 'slot'.
+    void Mark(const Slot* slot)
+    {
+        for (int level = 0; level < kMaxLevels; level++)
+        {
+            Slot* slots = Slots(level);
+            if (slots == NULL) break;
+            if (slot >= slots && slot < slots + Capacity(level))
+            {
+                uint64 index              = slot - slots;
+                std::atomic<uint64>& word = Marks(level)[index / 64];
+                uint64 bit                = 1ULL << (index % 64);
+                if (!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit);
+                return;
+            }
+        }
+    }
+
+   private:
+    struct NoInit
+    {
+        void operator()(Slot* slot) const {}
+    };
+
+    // Slots of a level, followed by its mark bits.
+    inline uint64 LevelBytes(int level) const { return Capacity(level) * sizeof(Slot) + Capacity(level) / 8; }
+
+    Slot* MapLevel(int level)
+    {
+        // Zero-filled pages are exactly a level of EMPTY slots and clear marks.
+        void* mem = mmap(NULL, LevelBytes(level), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                         -1, 0);
+        if (mem == MAP_FAILED) DIE("Failed to map " << Capacity(level) << " " << name_ << " slots.");
+        return static_cast<Slot*>(mem);
+    }
+
+    // Returns level 'level', adding it if no other thread has yet.
+    Slot* AddLevel(int level)
+    {
+        Slot* slots    = MapLevel(level);
+        Slot* expected = NULL;
+        if (!levels_[level].compare_exchange_strong(expected, slots))
+        {
+            munmap(slots, LevelBytes(level));
+            slots = expected;
+        }
+        return slots;
+    }
+
+    template <typename Init>
+    Slot* Probe(Key key, bool claim, Init init)
+    {
+        for (int level = 0; level < kMaxLevels; level++)
+        {
+            Slot* slots = Slots(level);
+            if (slots == NULL)
+            {
+                // Every earlier level is full around 'key', so it can't be in
+                // this one yet.
+                if (!claim) return NULL;
+                slots = AddLevel(level);
+            }
+
+            uint64 mask = Capacity(level) - 1;
+            uint64 i    = HashKey(key) >> (shift_ - level);
+            for (uint64 probes = 0; probes < kMaxProbes; probes++, i = (i + 1) & mask)
+            {
+                Slot* slot   = &slots[i];
+                uint32 state = slot->state_.load(std::memory_order_acquire);
+                if (state == EMPTY)
+                {
+                    // A key takes the first empty slot it finds, so it has
+                    // none further on.
+                    if (!claim) return NULL;
+                    if (slot->state_.compare_exchange_strong(state, CLAIMED))
+                    {
+                        slot->key_ = key;
+                        init(slot);
+                        slot->state_.store(READY, std::memory_order_release);
+                        return slot;
+                    }
+                    // Lost the race for the slot; 'state' now holds the winner's state.
+                }
+                while (state == CLAIMED)
+                {
+                    sched_yield();
+                    state = slot->state_.load(std::memory_order_acquire);
+                }
+                if (slot->key_ == key) return slot;
+            }
+        }
+        if (!claim) return NULL;
+        DIE(name_ << " is full (" << kMaxLevels << " levels).");
+    }
+
+    const char* name_;
+    uint64 base_;  // Capacity of level 0
+    int shift_;    // 64 - log2(base_): a key's home slot in level l is HashKey(key) >> (shift_ - l)
+
+    std::atomic<Slot*> levels_[kMaxLevels];
+};
+
+#endif  // _SLOT_TABLE_H_
@@ -0,0 +1,175 @@
+#include "ssi_manager.h"
+
+SSIManager::SSIManager(MVCCStorage* storage) : storage_(storage), stable_(0), committed_base_(1)
+{
+    partitions_ = NewCacheAlignedArray<Partition>(kPartitions);
+}
+
+SSIManager::~SSIManager()
+{
+    // Attempts still referenced anywhere are released along with 'pool_'.
+    DeleteCacheAlignedArray(partitions_, kPartitions);
+}
+
+SSITxn* SSIManager::Begin(int snapshot)
+{
+    SSITxn* txn    = pool_.New();
+    txn->snapshot_ = snapshot;
+    return txn;
+}
+
+bool SSIManager::Read(SSITxn* txn, Key key, Value* result)
+{
+    // Any writer committing from now on finds this entry. One that committed
+    // earlier but after the snapshot is found by Commit() instead.
+    Partition& partition = PartitionFor(key);
+    partition.latch_.Lock();
+    partition.readers_[key].push_back(txn);
+    partition.latch_.Unlock();
+    return storage_->SnapshotRead(key, result, txn->snapshot_);
+}
+
+bool SSIManager::Commit(SSITxn* txn, const KeySet& readset, const KeySet& writeset, const KeyValueMap& writes)
+{
+    // The edges are only recorded if 'txn' commits: an aborted txn conflicts
+    // with no one.
+    vector<SSITxn*> out_edges;  // Committed txns that overwrote something 'txn' read
+    vector<SSITxn*> in_edges;   // Concurrent txns that read something 'txn' overwrites
+    vector<int> newer;
+    bool valid = true;
+
+    commit_latch_.Lock();
+
+    // Versions committed after the snapshot, of keys 'txn' read. Its write
+    // set is read too, so a version there is also a write-write conflict
+    // (first committer wins).
+    for (int pass = 0; pass < 2 && valid; pass++)
+    {
+        const KeySet& keys = (pass == 0) ? readset : writeset;
+        for (KeySet::const_iterator it = keys.begin(); it != keys.end() && valid; ++it)
+        {
+            newer.clear();
+            storage_->NewerVersions(*it, txn->snapshot_, &newer);
+            if (pass == 1 && !newer.empty()) valid = false;
+            for (uint32 i = 0; i < newer.size() && valid; i++)
+            {
+                SSITxn* writer = committed_[newer[i] - committed_base_];
+                // The writer would become a committed pivot.
+                if (writer->out_conflict_) valid = false;
+                out_edges.push_back(writer);
+            }
+        }
+    }
+
+    // Concurrent readers (still active, or committed after the snapshot) of
+    // the keys 'txn' overwrites: they did not see its writes.
+    for (KeyValueMap::const_iterator it = writes.begin(); it != writes.end() && valid; ++it)
+    {
+        Partition& partition = PartitionFor(it->first);
+        partition.latch_.Lock();
+        unordered_map<Key, vector<SSITxn*> >::iterator readers = partition.readers_.find(it->first);
+        if (readers != partition.readers_.end())
+        {
+            for (uint32 i = 0; i < readers->second.size() && valid; i++)
+            {
+                SSITxn* reader = readers->second[i];
+                int commit_ts  = reader->commit_ts_.load();
+                if (reader == txn || commit_ts <= txn->snapshot_) continue;
+                // The reader would become a committed pivot.
+                if (commit_ts != SSITxn::kActive && reader->in_conflict_) valid = false;
+                in_edges.push_back(reader);
+            }
+        }
+        partition.latch_.Unlock();
+    }
+
+    bool in  = txn->in_conflict_ || !in_edges.empty();
+    bool out = txn->out_conflict_ || !out_edges.empty();
+    if (in && out) valid = false;
+
+    if (valid)
+    {
+        // Read-only txns get a timestamp too, so that whether they overlapped
+        // a later writer can be told from its snapshot.
+        int commit_ts = stable_.load() + 1;
+        for (KeyValueMap::const_iterator it = writes.begin(); it != writes.end(); ++it)
+        {
+            storage_->Lock(it->first);
+            storage_->Write(it->first, it->second, commit_ts);
+            storage_->Unlock(it->first);
+        }
+        for (uint32 i = 0; i < out_edges.size(); i++) out_edges[i]->in_conflict_ = true;
+        for (uint32 i = 0; i < in_edges.size(); i++) in_edges[i]->out_conflict_ = true;
+        txn->in_conflict_  = in;
+        txn->out_conflict_ = out;
+        txn->commit_ts_.store(commit_ts);
+        committed_.push_back(txn);
+        stable_.store(commit_ts);
+    }
+    else
+    {
+        txn->commit_ts_.store(SSITxn::kAborted);
+    }
+
+    commit_latch_.Unlock();
+    finished_.Push(txn);
+    return valid;
+}
+
+void SSIManager::Abort(SSITxn* txn)
+{
+    commit_latch_.Lock();
+    txn->commit_ts_.store(SSITxn::kAborted);
+    commit_latch_.Unlock();
+    finished_.Push(txn);
+}
+
+void SSIManager::CollectGarbage(int low_watermark)
+{
+    // An attempt that aborted, or committed before 'low_watermark', overlaps
+    // no active or future txn, so nothing can conflict with it any more. Only
+    // attempts that had already finished before the SIREAD entries are swept
+    // may be freed: the sweep has then removed all their entries.
+    SSITxn* txn;
+    while (finished_.Pop(&txn)) retiring_.push_back(txn);
+
+    for (int i = 0; i < kPartitions; i++)
+    {
+        Partition& partition = partitions_[i];
+        partition.latch_.Lock();
+        unordered_map<Key, vector<SSITxn*> >::iterator it = partition.readers_.begin();
+        while (it != partition.readers_.end())
+        {
+            vector<SSITxn*>& readers = it->second;
+            uint32 kept              = 0;
+            for (uint32 j = 0; j < readers.size(); j++)
+                if (readers[j]->commit_ts_.load() >= low_watermark) readers[kept++] = readers[j];
+            readers.resize(kept);
+            if (readers.empty())
+                it = partition.readers_.erase(it);
+            else
+                ++it;
+        }
+        partition.latch_.Unlock();
+    }
+
+    // Versions newer than any snapshot are > low_watermark.
+    commit_latch_.Lock();
+    while (!committed_.empty() && committed_base_ <= low_watermark)
+    {
+        committed_.pop_front();
+        committed_base_++;
+    }
+    commit_latch_.Unlock();
+
+    uint32 size = retiring_.size();
+    for (uint32 i = 0; i < size; i++)
+    {
+        txn = retiring_.front();
+        retiring_.pop_front();
+        if (txn->commit_ts_.load() < low_watermark)
+            pool_.Delete(txn);
+        else
+            retiring_.push_back(txn);
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef _SSI_MANAGER_H_
+#define _SSI_MANAGER_H_
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "mvcc_storage.h"
+#include "txn.h"
+#include "utils/atomic.h"
+#include "utils/mutex.h"
+#include "utils/object_pool.h"
+
+using std::deque;
+using std::map;
+using std::set;
+using std::unordered_map;
+using std::vector;
+
+// Serializable snapshot isolation state of one txn attempt (a restarted txn
+// gets a new one).
+struct SSITxn
+{
+    SSITxn() : snapshot_(0), commit_ts_(kActive), in_conflict_(false), out_conflict_(false) {}
+
+    // Values of 'commit_ts_' other than a commit timestamp.
+    static const int kActive  = INT_MAX;
+    static const int kAborted = -1;
+
+    int snapshot_;                // Sees exactly the commits with timestamp <= snapshot_
+    std::atomic<int> commit_ts_;  // kActive, kAborted, or the commit timestamp
+
+    // Set once some concurrent txn T has an rw-antidependency T -> this (T
+    // read a version this txn overwrote), resp. this -> T. Guarded by the
+    // SSIManager's commit latch.
+    bool in_conflict_;
+    bool out_conflict_;
+};
+
+// Serializable snapshot isolation (Cahill et al.) on top of an MVCCStorage.
+//
+// Every txn reads the snapshot of the commits that were complete when it
+// started, without taking any lock, and buffers its writes. Commits are
+// serialized by a short critical section that applies first-committer-wins to
+// write-write conflicts and tracks rw-antidependencies between concurrent
+// txns, found in two ways:
+//
+//  - reads are recorded in a table of SIREAD entries, which a committing
+//    writer checks for concurrent readers of the keys it overwrites;
+//  - a committing txn checks the keys it read for versions committed after
+//    its snapshot.
+//
+// A txn that would become the pivot of a dangerous structure (an rw edge in
+// and an rw edge out) is aborted. Readers never wait for writers, and a
+// writer is only ever aborted because of a reader if the two are part of such
+// a structure.
+class SSIManager
+{
+   public:
+    // Commits are installed into '*storage' (which the SSIManager doesn't own)
+    // with timestamps 1, 2, ... so 'storage' must only hold the initial image
+    // (version 0).
+    explicit SSIManager(MVCCStorage* storage);
+    ~SSIManager();
+
+    // Returns the snapshot a txn starting now should read: the timestamp of
+    // the last commit, all of whose writes are installed.
+    int Snapshot() const { return stable_.load(); }
+
+    // Starts a txn attempt reading as of 'snapshot'.
+    //
+    // Requires: 'snapshot' <= Snapshot(), and stays >= the low watermark
+    //           passed to CollectGarbage() until the attempt finishes.
+    SSITxn* Begin(int snapshot);
+
+    // Reads 'key' as of 'txn's snapshot and records the read. Returns false if
+    // the key has no version in the snapshot.
+    bool Read(SSITxn* txn, Key key, Value* result);
+
+    // Tries to commit 'txn', which read the keys in 'readset' and 'writeset'
+    // and wants to apply 'writes'. Returns true and installs the writes if it
+    // can commit, else returns false (the txn must be restarted). Either way
+    // the attempt is finished and 'txn' must not be used again.
+    bool Commit(SSITxn* txn, const KeySet& readset, const KeySet& writeset, const KeyValueMap& writes);
+
+    // Finishes 'txn' without committing it.
+    void Abort(SSITxn* txn);
+
+    // Forgets the reads and frees the state of finished attempts that can no
+    // longer conflict with any txn, given that every active and future txn
+    // reads a snapshot >= 'low_watermark'. Must only be called by one thread
+    // at a time.
+    void CollectGarbage(int low_watermark);
+
+   private:
+    // SIREAD entries, partitioned by key: the attempts that read each key.
+    struct alignas(CACHE_LINE_SIZE) Partition
+    {
+        Mutex latch_;
+        unordered_map<Key, vector<SSITxn*> > readers_;
+    };
+    static const int kPartitions = 256;
+
+    inline Partition& PartitionFor(Key key) { return partitions_[(HashKey(key) >> 32) & (kPartitions - 1)]; }
+
+    MVCCStorage* storage_;
+    Partition* partitions_;
+
+    // Serializes commits. Guards the rw-conflict flags of all attempts and
+    // 'committed_'.
+    Mutex commit_latch_;
+
+    // Timestamp of the last commit; only changes under 'commit_latch_', after
+    // the commit's writes are installed.
+    std::atomic<int> stable_;
+
+    // Committed attempts, by commit timestamp: committed_[i] committed at
+    // 'committed_base_' + i. Used to find the writers of newer versions.
+    deque<SSITxn*> committed_;
+    int committed_base_;
+
+    ObjectPool<SSITxn> pool_;
+
+    // Attempts that finished, for the collector.
+    AtomicQueue<SSITxn*> finished_;
+
+    // Finished attempts the collector has not freed yet (only touched by the
+    // thread calling CollectGarbage()).
+    deque<SSITxn*> retiring_;
+};
+
+#endif  // _SSI_MANAGER_H_
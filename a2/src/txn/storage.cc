@@ -4,43 +4,29 @@
 
 bool Storage::Read(Key key, Value* result, int txn_unique_id)
 {
-    if (data_.count(key))
-    {
-        *result = data_[key];
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    Record* record = records_.Find(key);
+    if (record == NULL) return ReadImage(key, result);
+    *result = record->value_;
+    return true;
 }
 
-
-
-
 // Write value and timestamps
 void Storage::Write(Key key, Value value, int txn_unique_id)
 {
-    data_[key]       = value;
-    timestamps_[key] = GetTime();
+    Record* record           = records_.Insert(key);
+    record->value_           = value;
+    record->timestamp_       = GetTime();
+    record->committed_index_ = txn_unique_id;
 }
 
-
-
 double Storage::Timestamp(Key key)
 {
-    if (timestamps_.count(key) == 0) return 0;
-    return timestamps_[key];
+    Record* record = records_.Find(key);
+    return record == NULL ? 0 : record->timestamp_;
 }
 
 // Init the storage
-void Storage::InitStorage()
-{
-    for (int i = 0; i < 1000000; i++)
-    {
-        Write(i, 0, 0);
-    }
-}
+void Storage::InitStorage() { AttachImage(StorageImage::Default()); }
 
 // void Storage::reupdate_read(Key key, int txn_unique_id,int previous_tmp)
 // {
@@ -6,6 +6,8 @@
 #include <map>
 #include <unordered_map>
 
+#include "record_table.h"
+#include "storage_image.h"
 #include "txn.h"
 #include "utils/mutex.h"
 
@@ -34,8 +36,16 @@ class Storage
 
    
 
-    // Init storage
+    // Init storage: keys 0 .. kInitKeys - 1 exist, all with value 0. This just
+    // attaches the shared StorageImage::Default(), so it costs O(1); records
+    // are only materialized when first written.
     virtual void InitStorage();
+    static const Key kInitKeys = 1000000;
+
+    // Makes every key in 'image' readable through this storage (with timestamp
+    // 0) until it is overwritten. Must be called before the storage is shared
+    // with other threads.
+    void AttachImage(const shared_ptr<const StorageImage>& image) { image_ = image; }
 
     virtual ~Storage() {}
     // The following methods are only used for MVCC
@@ -45,20 +55,20 @@ class Storage
 
     virtual bool CheckWrite1(Key key, int txn_unique_id) { return true; }
   //  virtual void reupdate_read(Key key, int txn_unique_id,int previous_tmp);
+   protected:
+    // If 'key' is in the attached image, sets '*result' to its initial value
+    // and returns true, else returns false.
+    inline bool ReadImage(Key key, Value* result) { return image_ && image_->Read(key, result); }
+
    private:
     friend class TxnProcessor;
 
-    // Collection of <key, value> pairs. Use this for single-version storage
-    unordered_map<Key, Value> data_;
-
-    // Timestamps at which each key was last updated.
-    unordered_map<Key, double> timestamps_;
-
-
-    // Last wrote committed indexs at which each key was last updated.
-    unordered_map<Key, int> committed_indexs_;
-
+    // Frozen initial contents shared with other storages (may be NULL).
+    shared_ptr<const StorageImage> image_;
 
+    // Single-version records: value, last-write timestamp and last committed
+    // writer of each key, stored together in one slot.
+    RecordTable records_;
 };
 
 #endif  // _STORAGE_H_
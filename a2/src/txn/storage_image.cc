@@ -0,0 +1,32 @@
+#include "storage_image.h"
+
+#include <sys/mman.h>
+
+#include "storage.h"
+
+StorageImage::StorageImage(Key num_keys, Value value) : num_keys_(num_keys)
+{
+    // Anonymous mappings start out zero-filled, so an all-zero image costs
+    // nothing until it is read (and then only one shared zero page per page).
+    size_t bytes = num_keys_ * sizeof(Value);
+    void* mem    = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) DIE("Failed to map storage image of " << num_keys_ << " keys.");
+    values_ = static_cast<Value*>(mem);
+
+    if (value != 0)
+        for (Key key = 0; key < num_keys_; key++) values_[key] = value;
+
+    // Freeze the image: any stray write through it faults instead of silently
+    // corrupting the state shared by every attached Storage.
+    mprotect(values_, bytes, PROT_READ);
+}
+
+StorageImage::~StorageImage() { munmap(values_, num_keys_ * sizeof(Value)); }
+
+shared_ptr<const StorageImage> StorageImage::Default()
+{
+    // Function-local statics are initialized exactly once, even if several
+    // TxnProcessors are constructed concurrently.
+    static shared_ptr<const StorageImage> image(new StorageImage(Storage::kInitKeys, 0));
+    return image;
+}
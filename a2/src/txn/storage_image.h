@@ -0,0 +1,51 @@
+#ifndef _STORAGE_IMAGE_H_
+#define _STORAGE_IMAGE_H_
+
+#include <memory>
+
+#include "utils/common.h"
+
+using std::shared_ptr;
+
+/// @class StorageImage
+///
+/// A frozen initial database image: one value for every key in
+/// [0, NumKeys()). The image is built once, write-protected, and shared by any
+/// number of Storage instances. Storage engines attached to an image serve
+/// reads of keys they have never written from it, and only materialize a
+/// record of their own on first write (copy-on-write), so attaching to an
+/// image costs O(1) no matter how large it is.
+class StorageImage
+{
+   public:
+    // Builds an image of keys [0, num_keys), all holding 'value'.
+    StorageImage(Key num_keys, Value value);
+    ~StorageImage();
+
+    // Returns the image InitStorage() attaches to: keys
+    // [0, Storage::kInitKeys), all holding 0. Built on first use and shared by
+    // every caller after that.
+    static shared_ptr<const StorageImage> Default();
+
+    // If 'key' is in the image, sets '*result' to its value and returns true,
+    // else returns false. Safe to call from any thread.
+    inline bool Read(Key key, Value* result) const
+    {
+        if (key >= num_keys_) return false;
+        *result = values_[key];
+        return true;
+    }
+
+    Key NumKeys() const { return num_keys_; }
+
+   private:
+    // Disallow copying.
+    StorageImage(const StorageImage&);
+    StorageImage& operator=(const StorageImage&);
+
+    // Read-only mapping of 'num_keys_' values, indexed by key.
+    Value* values_;
+    Key num_keys_;
+};
+
+#endif  // _STORAGE_IMAGE_H_
@@ -0,0 +1,631 @@
+#include "storage.h"
+
+#include <pthread.h>
+#include <vector>
+
+#include "commit_log.h"
+#include "dense_storage.h"
+#include "key_intersect.h"
+#include "lock_free_mvcc_storage.h"
+#include "mvcc_storage.h"
+#include "record_table.h"
+#include "sharded_storage.h"
+#include "silo_storage.h"
+#include "ssi_manager.h"
+#include "tictoc_storage.h"
+#include "vll_storage.h"
+#include "utils/testing.h"
+
+TEST(RecordTable_InsertFind)
+{
+    RecordTable table;
+    EXPECT_TRUE(table.Find(5) == NULL);
+
+    // Enough inserts to force several rehashes.
+    for (Key key = 0; key < 100000; key++) table.Insert(key * 7)->value_ = key;
+    EXPECT_EQ(100000, table.Size());
+
+    bool all_found = true;
+    for (Key key = 0; key < 100000; key++)
+    {
+        Record* record = table.Find(key * 7);
+        if (record == NULL || record->key_ != key * 7 || record->value_ != key) all_found = false;
+    }
+    EXPECT_TRUE(all_found);
+    EXPECT_TRUE(table.Find(8) == NULL);
+
+    // Inserting an existing key returns the existing record.
+    EXPECT_EQ(3, table.Insert(21)->value_);
+    EXPECT_EQ(100000, table.Size());
+
+    END;
+}
+
+TEST(ShardedStorage_ReadWrite)
+{
+    ShardedStorage storage;
+    Value value;
+
+    EXPECT_FALSE(storage.Read(7, &value));
+    EXPECT_EQ(0, storage.Timestamp(7));
+
+    double before = GetTime();
+    storage.Write(7, 42);
+    EXPECT_TRUE(storage.Read(7, &value));
+    EXPECT_EQ(42, value);
+    EXPECT_TRUE(storage.Timestamp(7) >= before);
+
+    storage.Write(7, 43);
+    EXPECT_TRUE(storage.Read(7, &value));
+    EXPECT_EQ(43, value);
+
+    END;
+}
+
+TEST(ShardedStorage_InitStorage)
+{
+    ShardedStorage storage(4);
+    storage.InitStorage();
+    Value value = 1;
+
+    EXPECT_TRUE(storage.Read(0, &value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(storage.Read(999999, &value));
+    EXPECT_FALSE(storage.Read(1000000, &value));
+
+    END;
+}
+
+TEST(DenseStorage_ReadWrite)
+{
+    DenseStorage storage(100);
+    Value value;
+
+    // Never-written keys, inside and outside the dense range.
+    EXPECT_FALSE(storage.Read(5, &value));
+    EXPECT_FALSE(storage.Read(500, &value));
+    EXPECT_EQ(0, storage.Timestamp(5));
+
+    storage.Write(5, 50);
+    storage.Write(500, 5000);
+    EXPECT_TRUE(storage.Read(5, &value));
+    EXPECT_EQ(50, value);
+    EXPECT_TRUE(storage.Read(500, &value));
+    EXPECT_EQ(5000, value);
+    EXPECT_TRUE(storage.Timestamp(5) > 0);
+    EXPECT_TRUE(storage.Timestamp(500) > 0);
+
+    END;
+}
+
+TEST(DenseStorage_InitStorage)
+{
+    // Dense range smaller than the initial key range: the rest overflows.
+    DenseStorage storage(1000);
+    storage.InitStorage();
+    Value value = 1;
+
+    EXPECT_TRUE(storage.Read(0, &value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(storage.Read(999, &value));
+    EXPECT_TRUE(storage.Read(1000, &value));
+    EXPECT_TRUE(storage.Read(999999, &value));
+    EXPECT_FALSE(storage.Read(1000000, &value));
+
+    END;
+}
+
+TEST(StorageImage_CopyOnWrite)
+{
+    shared_ptr<const StorageImage> image(new StorageImage(10, 7));
+    Storage plain;
+    ShardedStorage sharded;
+    DenseStorage dense(5);
+    MVCCStorage mvcc;
+    Storage* storages[] = {&plain, &sharded, &dense, &mvcc};
+    Value value;
+
+    for (int i = 0; i < 4; i++)
+    {
+        storages[i]->AttachImage(image);
+        storages[i]->Write(3, 100 + i, 1);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        // Untouched keys come from the image, written keys are private.
+        EXPECT_TRUE(storages[i]->Read(8, &value, 2));
+        EXPECT_EQ(7, value);
+        EXPECT_TRUE(storages[i]->Read(3, &value, 2));
+        EXPECT_EQ(static_cast<Value>(100 + i), value);
+        EXPECT_FALSE(storages[i]->Read(10, &value, 2));
+    }
+    EXPECT_EQ(0, plain.Timestamp(8));
+
+    // The image itself never changes.
+    EXPECT_TRUE(image->Read(3, &value));
+    EXPECT_EQ(7, value);
+
+    END;
+}
+
+struct WriterArgs
+{
+    Storage* storage;
+    Key first;
+    int count;
+};
+
+static void* WriteRange(void* arg)
+{
+    WriterArgs* args = reinterpret_cast<WriterArgs*>(arg);
+    for (int round = 1; round <= 10; round++)
+        for (int i = 0; i < args->count; i++) args->storage->Write(args->first + i, round);
+    return NULL;
+}
+
+TEST(ShardedStorage_ConcurrentWriters)
+{
+    ShardedStorage storage;
+    const int kThreads = 8;
+    const int kKeys    = 10000;
+
+    std::vector<pthread_t> threads(kThreads);
+    std::vector<WriterArgs> args(kThreads);
+    for (int i = 0; i < kThreads; i++)
+    {
+        args[i].storage = &storage;
+        args[i].first   = i * kKeys;
+        args[i].count   = kKeys;
+        pthread_create(&threads[i], NULL, WriteRange, &args[i]);
+    }
+    for (int i = 0; i < kThreads; i++) pthread_join(threads[i], NULL);
+
+    bool all_written = true;
+    for (Key key = 0; key < kThreads * kKeys; key++)
+    {
+        Value value;
+        if (!storage.Read(key, &value) || value != 10) all_written = false;
+    }
+    EXPECT_TRUE(all_written);
+
+    END;
+}
+
+TEST(MVCCStorage_GarbageCollection)
+{
+    MVCCStorage storage;
+    storage.InitStorage();
+    for (int id = 1; id <= 5; id++) storage.Write(1, id * 10, id);
+    storage.Write(2, 7, 3);
+
+    // Everything is visible to some timestamp >= 0.
+    storage.CollectGarbage(0, MVCCStorage::kPartitions);
+    GCStats stats = storage.Stats();
+    EXPECT_EQ(stats.versions_reclaimed, 0);
+    EXPECT_EQ(stats.version_lists, 2);
+    EXPECT_EQ(stats.live_versions, 8);
+    EXPECT_EQ(stats.longest_chain, 6);
+
+    // Timestamps >= 3 can still see versions 3, 4 and 5 of key 1, and
+    // version 3 of key 2.
+    storage.CollectGarbage(3, MVCCStorage::kPartitions);
+    stats = storage.Stats();
+    EXPECT_EQ(stats.versions_reclaimed, 4);
+    EXPECT_EQ(stats.live_versions, 4);
+    EXPECT_EQ(stats.longest_chain, 3);
+
+    Value value;
+    EXPECT_TRUE(storage.Read(1, &value, 3));
+    EXPECT_EQ(value, 30);
+    EXPECT_TRUE(storage.Read(1, &value, 100));
+    EXPECT_EQ(value, 50);
+    EXPECT_TRUE(storage.Read(2, &value, 3));
+    EXPECT_EQ(value, 7);
+
+    // A sweep spread over several calls.
+    for (int i = 0; i < MVCCStorage::kPartitions / 16; i++) storage.CollectGarbage(100, 16);
+    stats = storage.Stats();
+    EXPECT_EQ(stats.versions_reclaimed, 6);
+    EXPECT_EQ(stats.live_versions, 2);
+    EXPECT_EQ(stats.longest_chain, 1);
+
+    END;
+}
+
+TEST(MVCCStorage_SnapshotRead)
+{
+    MVCCStorage storage;
+    storage.InitStorage();
+    for (int id = 2; id <= 6; id += 2)
+    {
+        storage.Lock(1);
+        storage.Write(1, id * 10, id);
+        storage.Unlock(1);
+    }
+
+    Value value;
+    EXPECT_TRUE(storage.SnapshotRead(1, &value, 1));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(storage.SnapshotRead(1, &value, 5));
+    EXPECT_EQ(value, 40);
+    EXPECT_TRUE(storage.SnapshotRead(1, &value, 100));
+    EXPECT_EQ(value, 60);
+    EXPECT_FALSE(storage.SnapshotRead(Storage::kInitKeys + 1, &value, 100));
+
+    // Snapshot reads leave max_read_id_ alone: txn 7 may still write.
+    EXPECT_TRUE(storage.CheckWrite(1, 7));
+
+    END;
+}
+
+TEST(MVCCStorage_GrowsPastCapacity)
+{
+    // The smallest table: kPartitions * 64 slots before it has to grow.
+    MVCCStorage storage(1);
+    const Key kKeys = MVCCStorage::kPartitions * 64 * 4;
+    Value value;
+
+    // Reads of keys that were never written claim nothing.
+    bool none_found = true;
+    for (Key key = 0; key < kKeys; key++)
+        if (storage.Read(key, &value, 1) || storage.SnapshotRead(key, &value, 1)) none_found = false;
+    EXPECT_TRUE(none_found);
+    EXPECT_EQ(storage.Stats().version_lists, 0);
+
+    for (Key key = 0; key < kKeys; key++) storage.Write(key, key + 1, 1);
+    bool all_found = true;
+    for (Key key = 0; key < kKeys; key++)
+        if (!storage.Read(key, &value, 2) || value != key + 1) all_found = false;
+    EXPECT_TRUE(all_found);
+    EXPECT_EQ(storage.Stats().version_lists, kKeys);
+    EXPECT_FALSE(storage.Read(kKeys, &value, 2));
+
+    // Chains in every level are collected.
+    for (Key key = 0; key < kKeys; key++) storage.Write(key, key + 2, 3);
+    storage.CollectGarbage(3, MVCCStorage::kPartitions);
+    EXPECT_EQ(storage.Stats().versions_reclaimed, kKeys);
+
+    END;
+}
+
+TEST(SSIManager_DangerousStructures)
+{
+    MVCCStorage storage;
+    storage.InitStorage();
+    SSIManager ssi(&storage);
+    KeySet none;
+    KeySet x;
+    KeySet y;
+    KeySet xy;
+    x.insert(1);
+    y.insert(2);
+    xy.insert(1);
+    xy.insert(2);
+    KeyValueMap write_x;
+    KeyValueMap write_y;
+    write_x[1] = 10;
+    write_y[2] = 20;
+    Value value;
+
+    // Write skew: both read x and y, then each writes one of them. The second
+    // committer would be the pivot of T1 -rw-> T2 -rw-> T1 and is aborted.
+    SSITxn* t1 = ssi.Begin(ssi.Snapshot());
+    SSITxn* t2 = ssi.Begin(ssi.Snapshot());
+    EXPECT_TRUE(ssi.Read(t1, 1, &value));
+    EXPECT_TRUE(ssi.Read(t1, 2, &value));
+    EXPECT_TRUE(ssi.Read(t2, 1, &value));
+    EXPECT_TRUE(ssi.Read(t2, 2, &value));
+    EXPECT_TRUE(ssi.Commit(t1, y, none, write_x));
+    EXPECT_FALSE(ssi.Commit(t2, x, none, write_y));
+    EXPECT_EQ(ssi.Snapshot(), 1);
+
+    // A reader of the old snapshot neither blocks nor aborts a writer, and
+    // still commits itself: the one rw edge is no dangerous structure.
+    SSITxn* reader = ssi.Begin(ssi.Snapshot());
+    SSITxn* writer = ssi.Begin(ssi.Snapshot());
+    EXPECT_TRUE(ssi.Read(reader, 1, &value));
+    EXPECT_EQ(value, 10);
+    EXPECT_TRUE(ssi.Read(writer, 1, &value));
+    write_x[1] = 11;
+    EXPECT_TRUE(ssi.Commit(writer, none, x, write_x));
+    EXPECT_TRUE(ssi.Read(reader, 1, &value));
+    EXPECT_EQ(value, 10);
+    EXPECT_TRUE(ssi.Commit(reader, x, none, KeyValueMap()));
+
+    // First committer wins.
+    SSITxn* t3 = ssi.Begin(ssi.Snapshot());
+    SSITxn* t4 = ssi.Begin(ssi.Snapshot());
+    EXPECT_TRUE(ssi.Read(t3, 2, &value));
+    EXPECT_TRUE(ssi.Read(t4, 2, &value));
+    EXPECT_TRUE(ssi.Commit(t3, none, y, write_y));
+    EXPECT_FALSE(ssi.Commit(t4, none, y, write_y));
+    EXPECT_EQ(ssi.Snapshot(), 4);
+
+    // With nothing active, every finished attempt can be freed.
+    ssi.CollectGarbage(ssi.Snapshot() + 1);
+    EXPECT_TRUE(storage.SnapshotRead(2, &value, ssi.Snapshot()));
+    EXPECT_EQ(value, 20);
+
+    END;
+}
+
+TEST(SiloStorage_TIDs)
+{
+    SiloStorage storage;
+    storage.InitStorage();
+    Value value;
+    uint64 tid;
+
+    // Image records are present with TID 0, others absent.
+    SiloStorage::Record* record = storage.RecordFor(1);
+    EXPECT_TRUE(SiloStorage::StableRead(record, &value, &tid));
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(tid, (uint64)SiloStorage::kPresentBit);
+    SiloStorage::Record* missing = storage.RecordFor(Storage::kInitKeys + 1);
+    EXPECT_FALSE(SiloStorage::StableRead(missing, &value, &tid));
+    EXPECT_EQ(tid, 0);
+    EXPECT_TRUE(storage.RecordFor(1) == record);
+
+    // A commit stamps the record with its TID and releases the lock.
+    uint64 commit_tid = SiloStorage::EpochTID(3) + SiloStorage::kSequenceUnit;
+    SiloStorage::Lock(record);
+    EXPECT_TRUE(record->tid_.load() & SiloStorage::kLockBit);
+    SiloStorage::Install(record, 7, commit_tid);
+    EXPECT_TRUE(SiloStorage::StableRead(record, &value, &tid));
+    EXPECT_EQ(value, 7);
+    EXPECT_EQ(tid, (commit_tid | SiloStorage::kPresentBit));
+    EXPECT_EQ(SiloStorage::Epoch(tid), 3);
+
+    // Non-transactional writes keep TIDs growing.
+    storage.Write(Storage::kInitKeys + 1, 9);
+    EXPECT_TRUE(storage.Read(Storage::kInitKeys + 1, &value));
+    EXPECT_EQ(value, 9);
+    EXPECT_TRUE(missing->tid_.load() > 0);
+
+    END;
+}
+
+TEST(TicTocStorage_Timestamps)
+{
+    TicTocStorage storage;
+    storage.InitStorage();
+    Value value;
+    uint64 word;
+
+    // Image records are present with wts = rts = 0, others absent.
+    TicTocStorage::Record* a = storage.RecordFor(1);
+    EXPECT_TRUE(TicTocStorage::StableRead(a, &value, &word));
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(TicTocStorage::WTS(word), 0);
+    EXPECT_EQ(TicTocStorage::RTS(word), 0);
+    TicTocStorage::Record* missing = storage.RecordFor(Storage::kInitKeys + 1);
+    EXPECT_FALSE(TicTocStorage::StableRead(missing, &value, &word));
+
+    // A reader committing at 5 extends rts, so a writer can't commit below it.
+    uint64 read_word = word;
+    TicTocStorage::StableRead(a, &value, &read_word);
+    EXPECT_TRUE(TicTocStorage::ValidateRead(a, read_word, 5, false));
+    EXPECT_EQ(TicTocStorage::RTS(a->word_.load()), 5);
+    TicTocStorage::Lock(a);
+    EXPECT_FALSE(TicTocStorage::ValidateRead(a, read_word, 6, false));
+    EXPECT_TRUE(TicTocStorage::ValidateRead(a, read_word, 3, false));
+    TicTocStorage::Install(a, 7, TicTocStorage::RTS(a->word_.load()) + 1);
+    EXPECT_TRUE(TicTocStorage::StableRead(a, &value, &word));
+    EXPECT_EQ(value, 7);
+    EXPECT_EQ(TicTocStorage::WTS(word), 6);
+
+    // The overwritten value can no longer be extended.
+    EXPECT_FALSE(TicTocStorage::ValidateRead(a, read_word, 3, false));
+
+    // An rts too far above wts moves wts up instead, keeping the value.
+    TicTocStorage::Record* b = storage.RecordFor(2);
+    TicTocStorage::StableRead(b, &value, &read_word);
+    uint64 far = TicTocStorage::kMaxDelta + 100;
+    EXPECT_TRUE(TicTocStorage::ValidateRead(b, read_word, far, false));
+    word = b->word_.load();
+    EXPECT_EQ(TicTocStorage::RTS(word), far);
+    EXPECT_EQ(TicTocStorage::WTS(word), 100);
+    EXPECT_TRUE(storage.Read(2, &value));
+    EXPECT_EQ(value, 0);
+
+    // Non-transactional writes land past rts.
+    storage.Write(2, 9);
+    EXPECT_TRUE(TicTocStorage::StableRead(b, &value, &word));
+    EXPECT_EQ(value, 9);
+    EXPECT_EQ(TicTocStorage::WTS(word), far + 1);
+
+    END;
+}
+
+TEST(VllStorage_Counters)
+{
+    VllStorage storage;
+    storage.InitStorage();
+    Value value;
+
+    // Image records are present and unlocked, others absent.
+    VllStorage::Record* a = storage.RecordFor(1);
+    EXPECT_TRUE(storage.Read(1, &value));
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(a->cx_.load(), 0);
+    EXPECT_EQ(a->cs_.load(), 0);
+    EXPECT_FALSE(storage.Read(Storage::kInitKeys + 1, &value));
+    EXPECT_TRUE(storage.RecordFor(1) == a);
+
+    // Shared locks are compatible with each other only.
+    EXPECT_TRUE(VllStorage::LockShared(a));
+    EXPECT_TRUE(VllStorage::LockShared(a));
+    EXPECT_FALSE(VllStorage::LockExclusive(a));
+    EXPECT_FALSE(VllStorage::LockShared(a));  // Queued behind the writer.
+    EXPECT_EQ(a->cx_.load(), 1);
+    EXPECT_EQ(a->cs_.load(), 3);
+    VllStorage::UnlockShared(a);
+    VllStorage::UnlockShared(a);
+    VllStorage::UnlockShared(a);
+    VllStorage::UnlockExclusive(a);
+
+    // An exclusive lock excludes everything.
+    EXPECT_TRUE(VllStorage::LockExclusive(a));
+    EXPECT_FALSE(VllStorage::LockExclusive(a));
+    VllStorage::UnlockExclusive(a);
+    EXPECT_FALSE(VllStorage::LockShared(a));
+    VllStorage::UnlockExclusive(a);
+    VllStorage::UnlockShared(a);
+    EXPECT_EQ(a->cx_.load(), 0);
+    EXPECT_EQ(a->cs_.load(), 0);
+
+    storage.Write(Storage::kInitKeys + 1, 9);
+    EXPECT_TRUE(storage.Read(Storage::kInitKeys + 1, &value));
+    EXPECT_EQ(value, 9);
+
+    END;
+}
+
+TEST(CommitLog_Conflicts)
+{
+    CommitLog log(4);
+    KeySet reads;
+    reads.insert(3);
+    reads.insert(5);
+    KeySignature read_sig;
+    read_sig.AddAll(reads);
+    KeyValueMap writes;
+    KeySignature write_sig;
+
+    uint64 start = log.Tail();
+    EXPECT_FALSE(log.Conflicts(start, reads, read_sig));
+    writes[1] = 0;
+    writes[4] = 0;
+    write_sig.Add(1);
+    write_sig.Add(4);
+    log.Append(writes, write_sig);
+    EXPECT_FALSE(log.Conflicts(start, reads, read_sig));
+
+    // A signature hit alone is not a conflict.
+    writes[3 + KeySignature::kBits] = 0;
+    write_sig.Add(3 + KeySignature::kBits);
+    log.Append(writes, write_sig);
+    EXPECT_FALSE(log.Conflicts(start, reads, read_sig));
+    writes[5] = 0;
+    write_sig.Add(5);
+    log.Append(writes, write_sig);
+    EXPECT_TRUE(log.Conflicts(start, reads, read_sig));
+    EXPECT_FALSE(log.Conflicts(log.Tail(), reads, read_sig));
+
+    // Oversized write sets conflict with every read set their signature hits.
+    uint64 later = log.Tail();
+    writes.clear();
+    write_sig.Clear();
+    for (Key key = 0; key < CommitLog::kMaxKeys; key++) writes[100 + key] = 0;
+    writes[3 + KeySignature::kBits] = 0;
+    for (KeyValueMap::iterator it = writes.begin(); it != writes.end(); ++it) write_sig.Add(it->first);
+    log.Append(writes, write_sig);
+    EXPECT_TRUE(log.Conflicts(later, reads, read_sig));
+
+    // Commits that were overwritten conflict with everything, too.
+    writes.clear();
+    write_sig.Clear();
+    later = log.Tail();
+    for (int i = 0; i < 4; i++) log.Append(writes, write_sig);
+    EXPECT_FALSE(log.Conflicts(later, reads, read_sig));
+    log.Append(writes, write_sig);
+    EXPECT_TRUE(log.Conflicts(later, reads, read_sig));
+    EXPECT_TRUE(log.Conflicts(start, reads, read_sig));
+
+    END;
+}
+
+TEST(SortedKeysIntersect_MatchesScalar)
+{
+    // Sizes around the SIMD block widths, keys dense enough to collide often.
+    for (int round = 0; round < 2000; round++)
+    {
+        set<Key> a, b;
+        int na = rand() % 12, nb = rand() % 40;
+        while ((int)a.size() < na) a.insert(rand() % 64);
+        while ((int)b.size() < nb) b.insert(rand() % 64);
+        vector<Key> va(a.begin(), a.end()), vb(b.begin(), b.end());
+
+        bool expected = false;
+        for (set<Key>::iterator it = a.begin(); it != a.end(); ++it) expected |= b.count(*it) > 0;
+        EXPECT_EQ(SortedKeysIntersect(va, vb), expected);
+        EXPECT_EQ(SortedKeysIntersect(vb, va), expected);
+        EXPECT_EQ(SortedKeysIntersectScalar(va.data(), va.size(), vb.data(), vb.size()), expected);
+    }
+
+    END;
+}
+
+TEST(LockFreeMVCCStorage_Timestamps)
+{
+    LockFreeMVCCStorage storage;
+    storage.InitStorage();
+    Value value;
+
+    // Txn 5 reads key 1, so txn 3 may no longer overwrite it, but txn 7 may.
+    EXPECT_EQ(storage.TryRead(1, 5, &value), LockFreeMVCCStorage::READ_OK);
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(storage.Install(1, 30, 3) == NULL);
+    AtomicVersion* v7 = storage.Install(1, 70, 7);
+    EXPECT_TRUE(v7 != NULL);
+
+    // The pending version is invisible to older txns, a conflict for newer
+    // ones, and blocks other writers.
+    EXPECT_EQ(storage.TryRead(1, 6, &value), LockFreeMVCCStorage::READ_OK);
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(storage.TryRead(1, 8, &value), LockFreeMVCCStorage::READ_CONFLICT);
+    EXPECT_TRUE(storage.Install(1, 90, 9) == NULL);
+
+    EXPECT_TRUE(storage.Validate(v7));
+    storage.Commit(v7);
+    EXPECT_EQ(storage.TryRead(1, 8, &value), LockFreeMVCCStorage::READ_OK);
+    EXPECT_EQ(value, 70);
+
+    // An aborted version is skipped by readers and writers alike.
+    AtomicVersion* v10 = storage.Install(2, 100, 10);
+    EXPECT_TRUE(v10 != NULL);
+    EXPECT_EQ(storage.TryRead(2, 12, &value), LockFreeMVCCStorage::READ_CONFLICT);
+    storage.Abort(v10);
+    EXPECT_EQ(storage.TryRead(2, 12, &value), LockFreeMVCCStorage::READ_OK);
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(storage.Install(2, 110, 11) == NULL);
+    AtomicVersion* v13 = storage.Install(2, 130, 13);
+    EXPECT_TRUE(v13 != NULL);
+    EXPECT_TRUE(storage.Validate(v13));
+    storage.Commit(v13);
+
+    // Keys outside the image have no version until written.
+    EXPECT_EQ(storage.TryRead(Storage::kInitKeys + 1, 20, &value), LockFreeMVCCStorage::READ_NOT_FOUND);
+
+    // Only the newest version visible at the watermark survives, along with
+    // anything in front of it: key 1 keeps 70, key 2 keeps 130.
+    storage.CollectGarbage(20, MVCCStorage::kPartitions);
+    GCStats stats = storage.Stats();
+    EXPECT_EQ(stats.versions_reclaimed, 3);
+    EXPECT_EQ(stats.live_versions, 2);
+    EXPECT_EQ(stats.longest_chain, 1);
+
+    END;
+}
+
+int main(int argc, char** argv)
+{
+    RecordTable_InsertFind();
+    ShardedStorage_ReadWrite();
+    ShardedStorage_InitStorage();
+    ShardedStorage_ConcurrentWriters();
+    DenseStorage_ReadWrite();
+    DenseStorage_InitStorage();
+    StorageImage_CopyOnWrite();
+    MVCCStorage_GarbageCollection();
+    MVCCStorage_SnapshotRead();
+    MVCCStorage_GrowsPastCapacity();
+    SSIManager_DangerousStructures();
+    SiloStorage_TIDs();
+    TicTocStorage_Timestamps();
+    VllStorage_Counters();
+    CommitLog_Conflicts();
+    SortedKeysIntersect_MatchesScalar();
+    LockFreeMVCCStorage_Timestamps();
+}
@@ -0,0 +1,100 @@
+#include "tictoc_storage.h"
+
+#include <sched.h>
+
+// Spins before a waiter on a locked record yields the CPU.
+#define TICTOC_SPINS_BEFORE_YIELD 64
+
+TicTocStorage::TicTocStorage(uint64 capacity) : records_(capacity, 1024, "TicTocStorage") {}
+
+TicTocStorage::~TicTocStorage() {}
+
+TicTocStorage::Record* TicTocStorage::RecordFor(Key key)
+{
+    return records_.FindOrClaim(key, [this](Record* record) { this->Seed(record); });
+}
+
+void TicTocStorage::Seed(Record* record)
+{
+    if (ReadImage(record->key_, &record->value_)) record->word_.store(kPresentBit, std::memory_order_relaxed);
+}
+
+bool TicTocStorage::StableRead(Record* record, Value* result, uint64* word)
+{
+    int spins = 0;
+    while (true)
+    {
+        uint64 before = record->word_.load(std::memory_order_acquire);
+        if (before & kLockBit)
+        {
+            if (++spins > TICTOC_SPINS_BEFORE_YIELD) sched_yield();
+            continue;
+        }
+        // The value may change under us; it is only used if wts shows it
+        // didn't (a reader extending rts meanwhile does no harm).
+        Value value = __atomic_load_n(&record->value_, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64 after = record->word_.load(std::memory_order_relaxed);
+        if (!(after & kLockBit) && WTS(after) == WTS(before))
+        {
+            *word = before;
+            if (before & kPresentBit) *result = value;
+            return before & kPresentBit;
+        }
+    }
+}
+
+void TicTocStorage::Lock(Record* record)
+{
+    int spins = 0;
+    while (true)
+    {
+        uint64 word = record->word_.load(std::memory_order_relaxed);
+        if (!(word & kLockBit) && record->word_.compare_exchange_weak(word, word | kLockBit, std::memory_order_acquire))
+            return;
+        if (++spins > TICTOC_SPINS_BEFORE_YIELD) sched_yield();
+    }
+}
+
+bool TicTocStorage::ValidateRead(Record* record, uint64 word, uint64 ts, bool locked_by_caller)
+{
+    while (true)
+    {
+        uint64 current = record->word_.load();
+        if (WTS(current) != WTS(word)) return false;
+        if (RTS(current) >= ts) return true;
+        // The caller is about to overwrite the record at 'ts' itself.
+        if (locked_by_caller) return true;
+        if (current & kLockBit) return false;
+
+        // Extend rts to 'ts'. If the delta doesn't fit, wts moves up instead:
+        // the value stays the same, but other readers of it will have to
+        // retry.
+        uint64 wts = WTS(current);
+        if (ts - wts > kMaxDelta) wts = ts - kMaxDelta;
+        uint64 extended = (wts << kWTSShift) | ((ts - wts) << kDeltaShift) | (current & kPresentBit);
+        if (record->word_.compare_exchange_weak(current, extended)) return true;
+    }
+}
+
+void TicTocStorage::Install(Record* record, Value value, uint64 ts)
+{
+    __atomic_store_n(&record->value_, value, __ATOMIC_RELAXED);
+    record->word_.store((ts << kWTSShift) | kPresentBit, std::memory_order_release);
+}
+
+bool TicTocStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    // A key without a record was never written: it only has its image value.
+    Record* record = records_.Find(key);
+    if (record == NULL) return ReadImage(key, result);
+    uint64 word;
+    return StableRead(record, result, &word);
+}
+
+void TicTocStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    Record* record = RecordFor(key);
+    Lock(record);
+    Install(record, value, RTS(record->word_.load(std::memory_order_relaxed)) + 1);
+}
@@ -0,0 +1,91 @@
+#ifndef _TICTOC_STORAGE_H_
+#define _TICTOC_STORAGE_H_
+
+#include <atomic>
+
+#include "slot_table.h"
+#include "storage.h"
+
+// Single-version storage for TicToc OCC. Every key owns one cache-line sized
+// record in a SlotTable (laid out like SiloStorage's) holding its value and
+// one word of metadata:
+//
+//    bit 0       lock bit, held while the record is being committed
+//    bit 1       set iff the record has a value
+//    bits 2..16  delta: rts - wts
+//    bits 17..63 wts, the logical time the value was written
+//
+// The value is valid over the logical interval [wts, rts]. Readers extend
+// rts when they commit later than it; keeping both timestamps in one word
+// lets them do so atomically with checking that the value is unchanged and
+// unlocked.
+class TicTocStorage : public Storage
+{
+   public:
+    struct alignas(CACHE_LINE_SIZE) Record
+    {
+        std::atomic<uint64> word_;
+        Value value_;
+        std::atomic<uint32> state_;  // See SlotTable
+        Key key_;
+    };
+
+    static const uint64 kLockBit    = 1;
+    static const uint64 kPresentBit = 2;
+    static const int kDeltaShift    = 2;
+    static const uint64 kMaxDelta   = (1 << 15) - 1;
+    static const int kWTSShift      = 17;
+
+    static inline uint64 WTS(uint64 word) { return word >> kWTSShift; }
+    static inline uint64 RTS(uint64 word) { return WTS(word) + ((word >> kDeltaShift) & kMaxDelta); }
+
+    // Number of distinct keys the default-constructed storage holds before
+    // its table has to grow.
+    static const uint64 kDefaultCapacity = 1 << 21;
+
+    // 'capacity' is rounded up to a power of two. The table is reserved up
+    // front but mapped lazily, so only records that are used cost memory, and
+    // grows past 'capacity' as needed.
+    explicit TicTocStorage(uint64 capacity = kDefaultCapacity);
+    virtual ~TicTocStorage();
+
+    // Returns the record of 'key', creating it on first access (seeded from
+    // the attached image, with wts = rts = 0).
+    Record* RecordFor(Key key);
+
+    // Sets '*word' to the record's (unlocked) metadata word and, if the record
+    // has a value, sets '*result' to it, such that the two belong together.
+    // Returns true iff the record has a value. Waits while the record is
+    // locked.
+    static bool StableRead(Record* record, Value* result, uint64* word);
+
+    // Spins until it holds the record's lock bit.
+    static void Lock(Record* record);
+
+    // Releases the lock of 'record' without changing it.
+    static void Unlock(Record* record) { record->word_.fetch_and(~kLockBit, std::memory_order_release); }
+
+    // Checks that the value read with metadata 'word' is still valid at
+    // logical time 'ts', extending the record's rts to 'ts' if needed.
+    // Returns false if the value was overwritten, or if it is locked by a
+    // committer other than the caller ('locked_by_caller') and its rts would
+    // have to be extended.
+    static bool ValidateRead(Record* record, uint64 word, uint64 ts, bool locked_by_caller);
+
+    // Sets the value of a record locked by the caller, with wts = rts = 'ts',
+    // and releases the lock.
+    static void Install(Record* record, Value value, uint64 ts);
+
+    // Non-transactional access (Write() stamps the record one past its rts).
+    // Read() never creates a record.
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key) { return 0; }
+
+   private:
+    void Seed(Record* record);
+
+    SlotTable<Record> records_;
+};
+
+#endif  // _TICTOC_STORAGE_H_
@@ -39,7 +39,7 @@ void Txn::Write(const Key& key, const Value& value)
 
 void Txn::CheckReadWriteSets()
 {
-    for (set<Key>::iterator it = writeset_.begin(); it != writeset_.end(); ++it)
+    for (KeySet::iterator it = writeset_.begin(); it != writeset_.end(); ++it)
     {
         if (readset_.count(*it) > 0)
         {
@@ -48,14 +48,42 @@ void Txn::CheckReadWriteSets()
     }
 }
 
+void Txn::FinalizeKeySets()
+{
+    readset_sig_.Clear();
+    readset_sig_.AddAll(readset_);
+    writeset_sig_.Clear();
+    writeset_sig_.AddAll(writeset_);
+}
+
+void Txn::Reset()
+{
+    readset_.clear();
+    writeset_.clear();
+    reads_.clear();
+    writes_.clear();
+    status_      = INCOMPLETE;
+    read_only_   = false;
+    read_locks_  = 0;
+    write_locks_ = 0;
+}
+
 void Txn::CopyTxnInternals(Txn* txn) const
 {
-    txn->readset_        = set<Key>(this->readset_);
-    txn->writeset_       = set<Key>(this->writeset_);
-    txn->reads_          = map<Key, Value>(this->reads_);
-    txn->writes_         = map<Key, Value>(this->writes_);
+    txn->readset_        = this->readset_;
+    txn->writeset_       = this->writeset_;
+    txn->readset_sig_    = this->readset_sig_;
+    txn->writeset_sig_   = this->writeset_sig_;
+    txn->reads_          = this->reads_;
+    txn->writes_         = this->writes_;
     txn->status_         = this->status_;
     txn->unique_id_      = this->unique_id_;
     txn->occ_start_idx_  = this->occ_start_idx_;
     txn->occ_start_time_ = this->occ_start_time_;
+    txn->gc_epoch_       = this->gc_epoch_;
+    txn->read_only_      = this->read_only_;
+    txn->snapshot_ts_    = this->snapshot_ts_;
+    txn->read_locks_     = this->read_locks_;
+    txn->write_locks_    = this->write_locks_;
+    txn->vll_slot_       = this->vll_slot_;
 }
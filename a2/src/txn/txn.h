@@ -1,16 +1,25 @@
 #ifndef _TXN_H_
 #define _TXN_H_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
 
+#include "key_signature.h"
+#include "lock_manager.h"
 #include "utils/common.h"
+#include "utils/flat_map.h"
 
 using std::map;
 using std::set;
 using std::vector;
 
+// Key containers of a Txn: sorted, contiguous, and allocation-free up to the
+// 32 keys that cover typical txns (bigger ones spill to the heap).
+typedef FlatSet<Key, 32> KeySet;
+typedef FlatMap<Key, Value, 32> KeyValueMap;
+
 // Txns can have five distinct status values:
 enum TxnStatus
 {
@@ -25,7 +34,7 @@ class Txn
 {
    public:
     // Commit vote defauls to false. Only by calling "commit"
-    Txn() : status_(INCOMPLETE) {}
+    Txn() : status_(INCOMPLETE), occ_pins_(0), read_only_(false), read_locks_(0), write_locks_(0), lock_owner_(this) {}
     virtual ~Txn() {}
     virtual Txn* clone() const = 0;  // Virtual constructor (copying)
 
@@ -34,6 +43,11 @@ class Txn
 
     // Returns the Txn's current execution status.
     TxnStatus Status() { return status_; }
+
+    // Returns true if the txn was declared read-only. TxnProcessor runs
+    // read-only txns outside the scheduler, against a consistent snapshot,
+    // without locks or validation.
+    bool ReadOnly() const { return read_only_; }
     // Checks for overlap in read and write sets. If any key appears in both,
     // an error occurs.
     void CheckReadWriteSets();
@@ -44,6 +58,21 @@ class Txn
     // to copy any new data structures you create.
     void CopyTxnInternals(Txn* txn) const;
 
+    // Builds the signatures of readset_ and writeset_ that validators work
+    // on. Called by TxnProcessor when the txn is submitted, once the sets are
+    // final.
+    void FinalizeKeySets();
+
+    // Returns the txn to the state of a newly constructed one (empty sets and
+    // buffers, INCOMPLETE, not read-only), keeping the memory of its buffers.
+    // Used to reuse recycled txns (see TxnProcessor::ReuseTxn()).
+    void Reset();
+
+    // Declares the txn read-only.
+    //
+    // Requires: writeset_ is empty.
+    void DeclareReadOnly() { read_only_ = true; }
+
     friend class TxnProcessor;
 
     // Method to be used inside 'Execute()' function when reading records from
@@ -85,17 +114,21 @@ class Txn
 
     // Set of all keys that may need to be read in order to execute the
     // transaction.
-    set<Key> readset_;
+    KeySet readset_;
 
     // Set of all keys that may be updated when executing the transaction.
-    set<Key> writeset_;
+    KeySet writeset_;
+
+    // Signatures of readset_ and writeset_ (see FinalizeKeySets()).
+    KeySignature readset_sig_;
+    KeySignature writeset_sig_;
 
     // Results of reads performed by the transaction.
-    map<Key, Value> reads_;
+    KeyValueMap reads_;
 
 
     // Key, Value pairs WRITTEN by the transaction.
-    map<Key, Value> writes_;
+    KeyValueMap writes_;
 
     // Transaction's current execution status.
     TxnStatus status_;
@@ -107,6 +140,30 @@ class Txn
     int64_t occ_start_idx_;
 
     double occ_start_time_;
+
+    // Number of parallel OCC validators that may still read the txn's key
+    // sets (see TxnProcessor::EnterActiveSet()).
+    std::atomic<int> occ_pins_;
+
+    // Epoch the txn was registered in for MVCC garbage collection.
+    uint64 gc_epoch_;
+
+    // Set by DeclareReadOnly().
+    bool read_only_;
+
+    // Timestamp a read-only txn reads at (MVCC modes only).
+    int snapshot_ts_;
+
+    // Number of keys of readset_ and writeset_, in key order, the txn has
+    // requested locks on so far (locking modes only).
+    uint32 read_locks_;
+    uint32 write_locks_;
+
+    // Handles of the txn's lock requests (locking modes only).
+    LockOwner lock_owner_;
+
+    // Position of the txn in the VLL scheduler's queue (VLL only).
+    uint64 vll_slot_;
 };
 
 #endif  // _TXN_H_
@@ -5,59 +5,184 @@
 #include <list>  
 #include <vector>  
 #include <algorithm> 
+#include <climits>
+#include <sched.h>
 #include <iterator> 
 
+#include "dense_storage.h"
+#include "key_intersect.h"
 #include "lock_manager.h"
+#include "sharded_storage.h"
 
 using namespace std;  
-// Thread & queue counts for StaticThreadPool initialization.
-#define THREAD_COUNT 8
 
-TxnProcessor::TxnProcessor(CCMode mode) : mode_(mode), tp_(THREAD_COUNT), next_unique_id_(1)
+// Rounds an idle scheduler, and polls an idle GetTxnResult(), keep busy-polling
+// before parking.
+#define SCHEDULER_SPIN_ROUNDS 2048
+#define RESULT_SPIN_ROUNDS 2048
+
+// Capacity of the rings of the request and result queues. Txns beyond it
+// spill to a latched list instead of making the producer wait (a client may
+// submit any number of txns before collecting results, and schedulers
+// re-enqueue restarted txns into their own input queue).
+#define TXN_QUEUE_CAPACITY (1 << 16)
+
+// MVCC garbage collection: partitions visited per GarbageCollection() step,
+// and the pause between steps.
+#define GC_PARTITIONS_PER_STEP 16
+#define GC_STEP_INTERVAL_US 1000
+
+// Length of a Silo epoch.
+#define SILO_EPOCH_INTERVAL_US 40000
+
+// Size in bits of the key filters of VLL's contention analysis (a power of
+// two), and the number of blocked txns from which the analysis runs even
+// while new txns keep arriving.
+#define VLL_FILTER_BITS (1 << 14)
+#define VLL_ANALYSIS_BLOCKED_TXNS 64
+
+// Unfinished txns VLL admits at most; later ones wait in the request queue.
+// The analysis walks all of them, so the window must not grow with the
+// client's backlog.
+#define VLL_MAX_ADMITTED_TXNS (1 << 12)
+
+// A Calvin epoch closes this long after its first txn arrived, or once it
+// holds this many txns.
+#define CALVIN_EPOCH_US 5000
+#define CALVIN_EPOCH_TXNS 256
+
+// Attempts of a read-only txn on single-version storage to read without
+// overlapping a commit, before it goes through the scheduler instead.
+#define READ_ONLY_ATTEMPTS 16
+
+// Placement of the worker threads.
+static CpuPlacement WorkerPlacement(const TxnProcessorOptions& options)
 {
+    CpuPlacement placement;
+    placement.cores     = options.worker_cores;
+    placement.numa_node = options.numa_node;
+    return placement;
+}
+
+// Placement of the scheduler and background threads ('core' < 0: not pinned
+// to one CPU).
+static CpuPlacement ThreadPlacement(const TxnProcessorOptions& options, int core)
+{
+    CpuPlacement placement;
+    if (core >= 0) placement.cores.push_back(core);
+    placement.numa_node = options.numa_node;
+    return placement;
+}
+
+TxnProcessor::TxnProcessor(CCMode mode, StorageLayout layout, const TxnProcessorOptions& options)
+    : mode_(mode),
+      options_(options),
+      tp_(options.worker_count, WorkerPlacement(options)),
+      next_unique_id_(1),
+      txn_requests_(TXN_QUEUE_CAPACITY),
+      completed_cursor_(0),
+      scheduler_idle_rounds_(0),
+      txn_results_(TXN_QUEUE_CAPACITY),
+      lm_(NULL),
+      ssi_(NULL),
+      epochs_(1),
+      silo_epoch_(1),
+      calvin_running_(0),
+      vll_front_(0),
+      vll_blocked_(0)
+{
+    if (options_.worker_count < 1) DIE("A TxnProcessor needs at least one worker thread.");
+
+    // The MVCC, Silo, TicToc and VLL storages keep per-record state of their
+    // own that DenseStorage has no room for.
+    if (layout == DENSE_STORAGE && (MVCCMode() || mode_ == OCC_SILO || mode_ == OCC_TICTOC || mode_ == VLL))
+        DIE("Mode " << mode_ << " has no DENSE_STORAGE layout.");
+
+    // Everything allocated below (storage, per-worker queues) goes on the
+    // chosen NUMA node.
+    if (options_.numa_node >= 0) SetNumaAllocationNode(options_.numa_node);
+
+    completed_txns_ = NewCacheAlignedArray<SPSCQueue<Txn*>>(options_.worker_count);
+    apply_counters_ = NewCacheAlignedArray<ApplyCounter>(options_.worker_count + 1);
+
+    // Workers take locks themselves; a txn a lock was granted to, once it
+    // holds all it asked for, resumes on the releasing worker.
+    LockManager::ReadyCallback resume = [this](Txn* txn) { tp_.AddTask([this, txn]() { this->LockingExecuteTxn(txn); }); };
     if (mode_ == LOCKING_EXCLUSIVE_ONLY)
-        lm_ = new LockManagerA(&ready_txns_);
-    else if (mode_ == LOCKING)
-        lm_ = new LockManagerB(&ready_txns_);
+        lm_ = new LockManagerA(resume);
+    else if (mode_ == LOCKING || mode_ == MVCC_MV2PL)
+        lm_ = new LockManagerB(resume);
+    else if (mode_ == LOCKING_WAIT_DIE)
+        lm_ = new LockManagerB(resume, WAIT_DIE);
+    else if (mode_ == LOCKING_WOUND_WAIT)
+        lm_ = new LockManagerB(resume, WOUND_WAIT);
+    else if (mode_ == CALVIN)
+        lm_ = new LockManagerB([this](Txn* txn) { tp_.AddTask([this, txn]() { this->CalvinExecuteTxn(txn); }); });
 
     // Create the storage
     if (mode_ == MVCC_MVTO || mode_ == MVCC_MV2PL)
     {
-        lm_ = new LockManagerB(&ready_txns_);   
         storage_ = new MVCCStorage();
     }
-    else
+    else if (mode_ == MVCC_MVTO_LOCK_FREE)
+    {
+        storage_ = new LockFreeMVCCStorage();
+    }
+    else if (mode_ == MVCC_SSI)
+    {
+        storage_ = new MVCCStorage();
+        ssi_     = new SSIManager(static_cast<MVCCStorage*>(storage_));
+    }
+    else if (mode_ == OCC_SILO)
+    {
+        storage_ = new SiloStorage();
+    }
+    else if (mode_ == OCC_TICTOC)
+    {
+        storage_ = new TicTocStorage();
+    }
+    else if (mode_ == VLL)
+    {
+        storage_ = new VllStorage();
+        vll_exclusive_.resize(VLL_FILTER_BITS / 64);
+        vll_shared_.resize(VLL_FILTER_BITS / 64);
+    }
+    else if (layout == DENSE_STORAGE)
+    {
+        storage_ = new DenseStorage();
+    }
+    else if (mode_ == SERIAL)
     {
         storage_ = new Storage();
     }
+    else
+    {
+        // Worker threads read and commit concurrently in every other mode.
+        storage_ = new ShardedStorage();
+    }
 
     storage_->InitStorage();
 
-    // Start 'RunScheduler()' running.
-
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
+    // Back to the default for the client's own allocations.
+    if (options_.numa_node >= 0) SetNumaAllocationNode(-1);
 
-#if !defined(_MSC_VER) && !defined(__APPLE__)
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    for (int i = 0; i < 7; i++)
-    {
-        CPU_SET(i, &cpuset);
-    }
-    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
-#endif
+    // Start 'RunScheduler()' running. Each thread places itself.
 
-    pthread_t scheduler_;
-    pthread_create(&scheduler_, &attr, StartScheduler, reinterpret_cast<void*>(this));
+    // 'stopped_' must be cleared before the scheduler thread starts polling it.
+    stopped_ = false;
+    pthread_create(&scheduler_thread_, NULL, StartScheduler, reinterpret_cast<void*>(this));
 
-    stopped_          = false;
-    scheduler_thread_ = scheduler_;
+    if (MVCCMode())
+        pthread_create(&gc_thread_, NULL, StartGarbageCollector, reinterpret_cast<void*>(this));
+    if (mode_ == OCC_SILO)
+        pthread_create(&silo_epoch_thread_, NULL, StartSiloEpochAdvancer, reinterpret_cast<void*>(this));
 }
 
 void* TxnProcessor::StartScheduler(void* arg)
 {
-    reinterpret_cast<TxnProcessor*>(arg)->RunScheduler();
+    TxnProcessor* processor = reinterpret_cast<TxnProcessor*>(arg);
+    PlaceCurrentThread(ThreadPlacement(processor->options_, processor->options_.scheduler_core), 0);
+    processor->RunScheduler();
     return NULL;
 }
 
@@ -65,36 +190,127 @@ TxnProcessor::~TxnProcessor()
 {
     // Wait for the scheduler thread to join back before destroying the object and its thread pool.
     stopped_ = true;
+    scheduler_wakeup_.NotifyAll();
     pthread_join(scheduler_thread_, NULL);
+    if (MVCCMode()) pthread_join(gc_thread_, NULL);
+    if (mode_ == OCC_SILO) pthread_join(silo_epoch_thread_, NULL);
 
-    if (mode_ == LOCKING_EXCLUSIVE_ONLY || mode_ == LOCKING || mode_ == MVCC_MV2PL || mode_ == MVCC_MVTO) delete lm_;
+    delete lm_;
+    delete ssi_;
 
     delete storage_;
+    DeleteCacheAlignedArray(completed_txns_, options_.worker_count);
+    DeleteCacheAlignedArray(apply_counters_, options_.worker_count + 1);
+
+    for (uint32 i = 0; i < recycled_txns_.size(); i++) delete recycled_txns_[i];
 }
 
 void TxnProcessor::NewTxnRequest(Txn* txn)
 {
+    // The txn's read and write sets are final from here on.
+    txn->FinalizeKeySets();
+
     // Atomically assign the txn a new number and add it to the incoming txn
     // requests queue.
     mutex_.Lock();
     txn->unique_id_ = next_unique_id_;
     next_unique_id_++;
-    txn_requests_.Push(txn);
+
+    // Deadlock prevention ages a txn from its first submission on.
+    txn->lock_owner_.SetTimestamp(txn->unique_id_);
+
+    // Read-only txns bypass the scheduler (except in SERIAL mode, whose
+    // storage is not thread-safe, and in MVCC_SSI, where a read-only txn can
+    // complete a dangerous structure and so takes part in conflict tracking).
+    // In the MVTO modes they read as of just before the oldest active txn:
+    // everything below it is final.
+    if (txn->ReadOnly() && mode_ != SERIAL && mode_ != MVCC_SSI)
+    {
+        if (SnapshotMode())
+        {
+            txn->snapshot_ts_ = epochs_.LowWatermark() - 1;
+            txn->gc_epoch_    = snapshots_.Enter(txn->snapshot_ts_);
+        }
+        mutex_.Unlock();
+        tp_.AddTask([this, txn]() { this->ExecuteReadOnlyTxn(txn); });
+        return;
+    }
+
+    EnqueueRequest(txn);
     mutex_.Unlock();
 }
 
 Txn* TxnProcessor::GetTxnResult()
 {
     Txn* txn;
+    int spins = 0;
     while (!txn_results_.Pop(&txn))
     {
-        // No result yet. Wait a bit before trying again (to reduce contention on
-        // atomic queues).
-        usleep(1);
+        // No result yet. Poll for a while, then sleep until one is returned.
+        if (++spins < RESULT_SPIN_ROUNDS)
+        {
+            CpuRelax();
+            continue;
+        }
+        uint32 ticket = results_ready_.PrepareWait();
+        if (txn_results_.Size() > 0)
+            results_ready_.CancelWait();
+        else
+            results_ready_.Wait(ticket);
     }
     return txn;
 }
 
+void TxnProcessor::EnqueueRequest(Txn* txn)
+{
+    txn_requests_.Push(txn);
+    scheduler_wakeup_.NotifyOne();
+}
+
+void TxnProcessor::ReturnResult(Txn* txn)
+{
+    txn_results_.Push(txn);
+    results_ready_.NotifyOne();
+}
+
+bool TxnProcessor::HasSchedulerWork()
+{
+    // A full VLL window only reopens once some txn completes.
+    bool admitting = mode_ != VLL || vll_queue_.size() < VLL_MAX_ADMITTED_TXNS;
+    if (admitting && txn_requests_.Size() > 0) return true;
+    for (int i = 0; i < options_.worker_count; i++)
+        if (completed_txns_[i].Size() > 0) return true;
+    return false;
+}
+
+void TxnProcessor::WaitForSchedulerWork()
+{
+    if (HasSchedulerWork())
+    {
+        scheduler_idle_rounds_ = 0;
+        return;
+    }
+    if (++scheduler_idle_rounds_ < SCHEDULER_SPIN_ROUNDS)
+    {
+        CpuRelax();
+        return;
+    }
+
+    uint32 ticket = scheduler_wakeup_.PrepareWait();
+    if (HasSchedulerWork() || stopped_)
+        scheduler_wakeup_.CancelWait();
+    else
+        scheduler_wakeup_.Wait(ticket);
+    scheduler_idle_rounds_ = 0;
+}
+
+void TxnProcessor::RecycleTxn(Txn* txn)
+{
+    recycled_txns_mutex_.Lock();
+    recycled_txns_.push_back(txn);
+    recycled_txns_mutex_.Unlock();
+}
+
 void TxnProcessor::RunScheduler()
 {
     switch (mode_)
@@ -124,7 +340,31 @@ void TxnProcessor::RunScheduler()
             RunMVCCMVTOScheduler();
             break;
         case MVCC_MV2PL:
-            RunMVCCMV2PLScheduler();
+            RunLockingScheduler();
+            break;
+        case MVCC_MVTO_LOCK_FREE:
+            RunMVCCMVTOScheduler();
+            break;
+        case MVCC_SSI:
+            RunSSIScheduler();
+            break;
+        case OCC_SILO:
+            RunSiloScheduler();
+            break;
+        case OCC_TICTOC:
+            RunSiloScheduler();
+            break;
+        case VLL:
+            RunVllScheduler();
+            break;
+        case CALVIN:
+            RunCalvinScheduler();
+            break;
+        case LOCKING_WAIT_DIE:
+            RunLockingScheduler();
+            break;
+        case LOCKING_WOUND_WAIT:
+            RunLockingScheduler();
             break;
     }
 }
@@ -144,7 +384,6 @@ void TxnProcessor::RunSerialScheduler()
             if (txn->Status() == COMPLETED_C)
             {
                 ApplyWrites(txn);
-                committed_txns_.Push(txn);
                 txn->status_ = COMMITTED;
             }
             else if (txn->Status() == COMPLETED_A)
@@ -158,101 +397,157 @@ void TxnProcessor::RunSerialScheduler()
             }
 
             // Return result to client.
-            txn_results_.Push(txn);
+            ReturnResult(txn);
         }
+
+        WaitForSchedulerWork();
     }
 }
 
 void TxnProcessor::RunLockingScheduler()
 {
+    // Workers acquire and release locks themselves (see LockingExecuteTxn());
+    // the scheduler only hands them new txns.
     Txn* txn;
     while (!stopped_)
     {
-        // Start processing the next incoming transaction request.
-        if (txn_requests_.Pop(&txn))
+        while (txn_requests_.Pop(&txn))
         {
-            bool blocked = false;
-            // Request read locks.
-            for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
-            {
-                if (!lm_->ReadLock(txn, *it))
-                {
-                    blocked = true;
-                }
-            }
+            txn->read_locks_  = 0;
+            txn->write_locks_ = 0;
+            tp_.AddTask([this, txn]() { this->LockingExecuteTxn(txn); });
+        }
 
-            // Request write locks.
-            for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
-            {
-                if (!lm_->WriteLock(txn, *it))
-                {
-                    blocked = true;
-                }
-            }
+        WaitForSchedulerWork();
+    }
+}
 
-            // If all read and write locks were immediately acquired, this txn is
-            // ready to be executed.
-            if (blocked == false)
-            {
-                ready_txns_.push_back(txn);
-            }
-        }
+void TxnProcessor::LockingExecuteTxn(Txn* txn)
+{
+    // A blocked request ends the task; the lock manager reruns it once the
+    // lock is granted, and it carries on with the next key.
+    bool locked = (mode_ == LOCKING_WAIT_DIE || mode_ == LOCKING_WOUND_WAIT) ? RequestLocksUnordered(txn)
+                                                                             : RequestLocksInKeyOrder(txn);
+    if (!locked) return;
 
-        // Process and commit all transactions that have finished running.
-        while (completed_txns_.Pop(&txn))
-        {
-            // Commit/abort txn according to program logic's commit/abort decision.
-            if (txn->Status() == COMPLETED_C)
-            {
-                ApplyWrites(txn);
-                committed_txns_.Push(txn);
-                txn->status_ = COMMITTED;
-            }
-            else if (txn->Status() == COMPLETED_A)
-            {
-                txn->status_ = ABORTED;
-            }
-            else
-            {
-                // Invalid TxnStatus!
-                DIE("Completed Txn has invalid TxnStatus: " << txn->Status());
-            }
+    if (mode_ == MVCC_MV2PL)
+    {
+        MVCC2PLExecuteTxn(txn);
+    }
+    else
+    {
+        ReadAndRunTxn(txn);
+        CommitOrAbortTxn(txn);
+    }
 
-            // Release read locks.
-            for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
-            {
-                lm_->Release(txn, *it);
-            }
-            // Release write locks.
-            for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
-            {
-                lm_->Release(txn, *it);
-            }
+    // Release all locks.
+    lm_->ReleaseAll(&txn->lock_owner_);
 
-            // Return result to client.
-            txn_results_.Push(txn);
-        }
+    // Return result to client.
+    ReturnResult(txn);
+}
 
-        // Start executing all transactions that have newly acquired all their
-        // locks.
-        while (ready_txns_.size())
+bool TxnProcessor::RequestLocksInKeyOrder(Txn* txn)
+{
+    // One at a time in key order (so no two txns ever wait for each other in
+    // a cycle), reads and writes merged.
+    const Key* reads  = txn->readset_.begin();
+    const Key* writes = txn->writeset_.begin();
+    uint32 read_count = txn->readset_.size(), write_count = txn->writeset_.size();
+    while (txn->read_locks_ < read_count || txn->write_locks_ < write_count)
+    {
+        bool granted;
+        if (txn->write_locks_ == write_count ||
+            (txn->read_locks_ < read_count && reads[txn->read_locks_] < writes[txn->write_locks_]))
+        {
+            granted = lm_->ReadLock(&txn->lock_owner_, reads[txn->read_locks_++]);
+        }
+        else
         {
-            // Get next ready txn from the queue.
-            txn = ready_txns_.front();
-            ready_txns_.pop_front();
+            // A key both read and written only needs the write lock.
+            if (txn->read_locks_ < read_count && reads[txn->read_locks_] == writes[txn->write_locks_])
+                txn->read_locks_++;
+            granted = lm_->WriteLock(&txn->lock_owner_, writes[txn->write_locks_++]);
+        }
+        if (!granted) return false;
+    }
+    return true;
+}
 
-            // Start txn running in its own thread.
-            tp_.AddTask([this, txn]() { this->ExecuteTxn(txn);});
+bool TxnProcessor::RequestLocksUnordered(Txn* txn)
+{
+    // Write locks first, then read locks: txns may wait for each other in a
+    // cycle, which the lock manager's policy breaks by choosing victims.
+    const Key* reads  = txn->readset_.begin();
+    const Key* writes = txn->writeset_.begin();
+    uint32 read_count = txn->readset_.size(), write_count = txn->writeset_.size();
+    while (true)
+    {
+        // Also checked once all locks are requested: a victim is rerun
+        // whether or not it got the lock it blocked on.
+        if (txn->lock_owner_.Aborted())
+        {
+            RestartLockingTxn(txn);
+            return false;
         }
+        if (txn->read_locks_ == read_count && txn->write_locks_ == write_count) return true;
+
+        bool granted = true;
+        if (txn->write_locks_ < write_count)
+            granted = lm_->WriteLock(&txn->lock_owner_, writes[txn->write_locks_++]);
+        else if (txn->writeset_.count(reads[txn->read_locks_]) == 0)
+            granted = lm_->ReadLock(&txn->lock_owner_, reads[txn->read_locks_++]);
+        else
+            txn->read_locks_++;  // A key both read and written only needs the write lock.
+        if (!granted) return false;
+    }
+}
+
+void TxnProcessor::RestartLockingTxn(Txn* txn)
+{
+    // Nothing was read or written yet.
+    lm_->ReleaseAll(&txn->lock_owner_);
+    mutex_.Lock();
+    txn->unique_id_ = next_unique_id_;
+    next_unique_id_++;
+    EnqueueRequest(txn);
+    mutex_.Unlock();
+}
+
+void TxnProcessor::CommitOrAbortTxn(Txn* txn)
+{
+    // Commit/abort txn according to program logic's commit/abort decision.
+    if (txn->Status() == COMPLETED_C)
+    {
+        ApplyWrites(txn);
+        txn->status_ = COMMITTED;
+    }
+    else if (txn->Status() == COMPLETED_A)
+    {
+        txn->status_ = ABORTED;
+    }
+    else
+    {
+        // Invalid TxnStatus!
+        DIE("Completed Txn has invalid TxnStatus: " << txn->Status());
     }
 }
 
 void TxnProcessor::ExecuteTxn(Txn* txn)
+{
+    ReadAndRunTxn(txn);
+
+    // Hand the txn back to the RunScheduler thread (the serial scheduler runs
+    // txns itself and needs no hand-back).
+    if (mode_ != SERIAL) CompleteTxn(txn);
+}
+
+void TxnProcessor::ReadAndRunTxn(Txn* txn)
 {
     txn->occ_start_time_ = GetTime();   
-    txn->occ_start_idx_ =  committed_txns_.Size();
+    txn->occ_start_idx_ = commit_log_.Tail();
     // Read everything in from readset.
-    for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -262,7 +557,7 @@ void TxnProcessor::ExecuteTxn(Txn* txn)
     }
 
     // Also read everything in from writeset.
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -271,18 +566,131 @@ void TxnProcessor::ExecuteTxn(Txn* txn)
 
     // Execute txn's program logic.
     txn->Run();
+}
+
+void TxnProcessor::CompleteTxn(Txn* txn)
+{
+    int worker = tp_.CurrentThread();
+    if (worker < 0) DIE("CompleteTxn() called outside of a worker thread.");
+    completed_txns_[worker].Push(txn);
+    scheduler_wakeup_.NotifyOne();
+}
+
+bool TxnProcessor::PopCompletedTxn(Txn** txn)
+{
+    for (int i = 0; i < options_.worker_count; i++)
+    {
+        int worker = (completed_cursor_ + i) % options_.worker_count;
+        if (completed_txns_[worker].Pop(txn))
+        {
+            completed_cursor_ = worker;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TxnProcessor::ExecuteReadOnlyTxn(Txn* txn)
+{
+    if (mode_ == OCC_SILO)
+    {
+        // With an empty write set, Silo's commit protocol only re-checks the
+        // TIDs of the records read: it takes no locks and writes nothing.
+        SiloExecuteTxn(txn);
+        return;
+    }
+    if (mode_ == OCC_TICTOC)
+    {
+        // The commit timestamp is the largest wts read; validation extends
+        // rts where needed but takes no locks and writes no values.
+        TicTocExecuteTxn(txn);
+        return;
+    }
+
+    if (SnapshotMode())
+    {
+        // Every version below the snapshot is final, and the collector keeps
+        // them while the snapshot is registered.
+        for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+        {
+            Value result;
+            bool found = (mode_ == MVCC_MVTO_LOCK_FREE)
+                             ? static_cast<LockFreeMVCCStorage*>(storage_)->SnapshotRead(*it, &result, txn->snapshot_ts_)
+                             : static_cast<MVCCStorage*>(storage_)->SnapshotRead(*it, &result, txn->snapshot_ts_);
+            if (found) txn->reads_[*it] = result;
+        }
+        snapshots_.Exit(txn->gc_epoch_);
+    }
+    else
+    {
+        // Single-version data (MV2PL's version ids don't follow its
+        // serialization order, so its chains are no snapshot either): read
+        // the latest values, and retry if any commit was being applied
+        // meanwhile. Reads that overlapped no commit all saw the same
+        // committed state.
+        for (int attempt = 0;; attempt++)
+        {
+            // Under a steady stream of commits, let the scheduler run it like
+            // any other txn.
+            if (attempt == READ_ONLY_ATTEMPTS)
+            {
+                EnqueueRequest(txn);
+                return;
+            }
+            uint64 applied, settled;
+            if (SettledApplyCount(&applied))
+            {
+                for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+                {
+                    Value result;
+                    bool found = (mode_ == MVCC_MV2PL)
+                                     ? static_cast<MVCCStorage*>(storage_)->SnapshotRead(*it, &result, INT_MAX)
+                                     : storage_->Read(*it, &result);
+                    if (found) txn->reads_[*it] = result;
+                }
+                if (SettledApplyCount(&settled) && settled == applied) break;
+                txn->reads_.clear();
+            }
+            sched_yield();
+        }
+    }
+
+    txn->Run();
+    txn->status_ = (txn->Status() == COMPLETED_C) ? COMMITTED : ABORTED;
+    ReturnResult(txn);
+}
 
-    // Hand the txn back to the RunScheduler thread.
-    completed_txns_.Push(txn);
+bool TxnProcessor::SettledApplyCount(uint64* applied)
+{
+    *applied = 0;
+    for (int i = 0; i <= options_.worker_count; i++)
+    {
+        *applied += apply_counters_[i].applied_.load();
+        if (apply_counters_[i].applying_.load() != 0) return false;
+    }
+    return true;
 }
 
 void TxnProcessor::ApplyWrites(Txn* txn)
 {
+    // Let read-only txns on single-version storage see that a commit is in
+    // progress (see ExecuteReadOnlyTxn()), on the calling thread's counter.
+    bool tracked = !SnapshotMode();
+    int self     = tp_.CurrentThread();
+    ApplyCounter& counter = apply_counters_[self < 0 ? options_.worker_count : self];
+    if (tracked) counter.applying_.fetch_add(1);
+
     // Write buffered writes out to storage.
-    for (map<Key, Value>::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it)
+    for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it)
     {
         storage_->Write(it->first, it->second, txn->unique_id_);
     }
+
+    if (tracked)
+    {
+        counter.applied_.fetch_add(1);
+        counter.applying_.fetch_sub(1);
+    }
 }
 
 void TxnProcessor::RunOCCSerialSchedulerForwardValidation() {
@@ -296,13 +704,11 @@ void TxnProcessor::RunOCCSerialSchedulerForwardValidation() {
         }
 
         // Process and commit all transactions that have finished running.
-        while (completed_txns_.Pop(&txn)) {
+        while (PopCompletedTxn(&txn)) {
             bool isvalid = SerialValidate(txn);
             if(isvalid) {
-                ApplyWrites(txn);
-                committed_txns_.Push(txn);
-                txn->status_ = COMMITTED;
-                txn_results_.Push(txn);
+                CommitOrAbortTxn(txn);
+                ReturnResult(txn);
             } else {
                 txn->reads_.clear();
                 txn->writes_.clear();
@@ -310,10 +716,12 @@ void TxnProcessor::RunOCCSerialSchedulerForwardValidation() {
                 mutex_.Lock();
                 txn->unique_id_ = next_unique_id_;
                 next_unique_id_++;
-                txn_requests_.Push(txn);
+                EnqueueRequest(txn);
                 mutex_.Unlock();
             }
         }
+
+        WaitForSchedulerWork();
     }
 }
 
@@ -330,26 +738,15 @@ void TxnProcessor::RunOCCSerialSchedulerBackwardValidation() {
         }
 
         // Process and commit all transactions that have finished running.
-        while (completed_txns_.Pop(&txn)) {
-            bool isvalid = true;
-            for(int i = txn->occ_start_idx_ + 1; i<committed_txns_.Size() && isvalid;i++) {
-                Txn* past_txn = committed_txns_.operator[](i);
-               // cout<<past_txn->readset_.size()<<"\n";
-                for (set<Key>::iterator it = past_txn->writeset_.begin(); it != past_txn->writeset_.end() && isvalid; ++it){
-                    for (set<Key>::iterator it1 = txn->readset_.begin(); it1 != txn->readset_.end(); ++it1)
-                    {
-                       if(*it1 == *it) {
-                         isvalid = false;
-                         break;
-                       }
-                    }
-                }
-           }
+        while (PopCompletedTxn(&txn)) {
+            // Check the commits since the txn started against its read and
+            // write sets (it read the keys it writes, too).
+            bool isvalid = !commit_log_.Conflicts(txn->occ_start_idx_, txn->readset_, txn->readset_sig_) &&
+                           !commit_log_.Conflicts(txn->occ_start_idx_, txn->writeset_, txn->writeset_sig_);
             if(isvalid) {
-                ApplyWrites(txn);
-                committed_txns_.Push(txn);
-                txn->status_ = COMMITTED;
-                txn_results_.Push(txn);
+                CommitOrAbortTxn(txn);
+                commit_log_.Append(txn->writes_, txn->writeset_sig_);
+                ReturnResult(txn);
             } else {
                 txn->reads_.clear();
                 txn->writes_.clear();
@@ -357,11 +754,12 @@ void TxnProcessor::RunOCCSerialSchedulerBackwardValidation() {
                 mutex_.Lock();
                 txn->unique_id_ = next_unique_id_;
                 next_unique_id_++;
-                txn_requests_.Push(txn);
+                EnqueueRequest(txn);
                 mutex_.Unlock();
             } 
         }
-       
+
+        WaitForSchedulerWork();
     }
 }
 
@@ -375,6 +773,8 @@ void TxnProcessor::RunOCCParallelSchedulerForwardValidation() {
         {
             tp_.AddTask([this, txn]() {this->ExecuteTxnParallelForwardValidation(txn);});
         }
+
+        WaitForSchedulerWork();
     }
 
 }
@@ -388,6 +788,8 @@ void TxnProcessor::RunOCCParallelSchedulerBackwardValidation() {
         {
             tp_.AddTask([this, txn]() {this->ExecuteTxnParallelBackwardValidation(txn);});
         }
+
+        WaitForSchedulerWork();
     }
 }
 
@@ -399,17 +801,24 @@ void TxnProcessor::RunMVCCMVTOScheduler()
         // Start processing the next incoming transaction request.
         if (txn_requests_.Pop(&txn))
         {
-            tp_.AddTask([this, txn]() {this->MVCCMVTOExecuteTxn(txn);});
+            // Txns are popped in unique_id_ order, as EpochManager requires.
+            txn->gc_epoch_ = epochs_.Enter(txn->unique_id_);
+            if (mode_ == MVCC_MVTO_LOCK_FREE)
+                tp_.AddTask([this, txn]() {this->LockFreeMVTOExecuteTxn(txn);});
+            else
+                tp_.AddTask([this, txn]() {this->MVCCMVTOExecuteTxn(txn);});
         }
+
+        WaitForSchedulerWork();
     }
 }
 
 void  TxnProcessor::ExecuteTxnParallelBackwardValidation(Txn* txn) {
     // Get the current commited transaction index for the further validation.
-    txn->occ_start_idx_ = committed_txns_.Size();
+    txn->occ_start_idx_ = commit_log_.Tail();
     
     // Read everything in from readset.
-    for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -417,7 +826,7 @@ void  TxnProcessor::ExecuteTxnParallelBackwardValidation(Txn* txn) {
     }
 
     // Also read everything in from writeset.
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -427,66 +836,32 @@ void  TxnProcessor::ExecuteTxnParallelBackwardValidation(Txn* txn) {
     // Execute txn's program logic.
     txn->Run();
     
-    active_set_mutex_.Lock();
-    set<Txn*> finish = active_set_.GetSet();
-    active_set_.Insert(txn);
-    active_set_mutex_.Unlock();
-    bool isvalid = true;
-    set<Key> interset;
-    for (set<Key>::iterator it2 = txn->readset_.begin(); it2 != txn->readset_.end(); ++it2)
-    {
-        interset.insert(*it2);
-    }
-    for(int i = txn->occ_start_idx_ + 1; i<committed_txns_.Size() && isvalid;i++) {
-        Txn* past_txn = committed_txns_.operator[](i);
-        for (map<Key, Value>::iterator it = past_txn->writes_.begin(); it != past_txn->writes_.end() && isvalid; ++it){
-            for (set<Key>::iterator it1 = interset.begin(); it1 != interset.end(); ++it1)
-            {
-                if(*it1 == it->first) {
-                    isvalid = false;
-                    break;
-                }
-            }
-        }
-    }
-    if(isvalid) {
-        for (set<Key>::iterator it3 = txn->writeset_.begin(); it3 != txn->writeset_.end(); ++it3)
-        {
-            interset.insert(*it3);
-        }
-        for (set<Txn*>::iterator it = finish.begin(); it != finish.end() && isvalid; ++it)
-        {
-            Txn* past_txn = *it;
-            for (set<Key>::iterator it1 = past_txn->writeset_.begin(); it1 != past_txn->writeset_.end() && isvalid; ++it1){
-
-                for (set<Key>::iterator it2 = interset.begin(); it2 != interset.end(); ++it2)
-                {
-                    if(*it1 == *it2) {
-                        isvalid = false;
-                        break;
-                    }
-                }
-            }
-        }
-    }
+    set<Txn*> finish;
+    EnterActiveSet(txn, &finish);
+    // Check the commits since the txn started against its read and write
+    // sets, then the txns validating concurrently.
+    bool isvalid = !commit_log_.Conflicts(txn->occ_start_idx_, txn->readset_, txn->readset_sig_) &&
+                   !commit_log_.Conflicts(txn->occ_start_idx_, txn->writeset_, txn->writeset_sig_) &&
+                   !ConflictsWithActive(txn, finish);
+    UnpinActive(finish);
     if(isvalid) {
-        ApplyWrites(txn);
-        txn->status_ = COMMITTED;
-        txn_results_.Push(txn);
-        committed_txns_.Push(txn);
+        CommitOrAbortTxn(txn);
+        commit_log_.Append(txn->writes_, txn->writeset_sig_);
+        // Leave the active set before handing the txn back: the client may
+        // delete it as soon as it is in 'txn_results_'.
+        LeaveActiveSet(txn);
+        ReturnResult(txn);
     } else {
+        LeaveActiveSet(txn);
         txn->reads_.clear();
         txn->writes_.clear();
         txn->status_ = INCOMPLETE;
         mutex_.Lock();
         txn->unique_id_ = next_unique_id_;
         next_unique_id_++;
-        txn_requests_.Push(txn);
+        EnqueueRequest(txn);
         mutex_.Unlock();
     }
-    active_set_mutex_.Lock();
-    active_set_.Erase(txn);
-    active_set_mutex_.Unlock();
     finish.clear();
 }
 
@@ -496,7 +871,7 @@ void  TxnProcessor::ExecuteTxnParallelForwardValidation(Txn* txn) {
     txn->occ_start_time_ = GetTime();
     
     // Read everything in from readset.
-    for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -504,7 +879,7 @@ void  TxnProcessor::ExecuteTxnParallelForwardValidation(Txn* txn) {
     }
 
     // Also read everything in from writeset.
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
@@ -513,55 +888,67 @@ void  TxnProcessor::ExecuteTxnParallelForwardValidation(Txn* txn) {
 
     // Execute txn's program logic.
     txn->Run();
-    active_set_mutex_.Lock();
-    set<Txn*> finish = active_set_.GetSet();
-    active_set_.Insert(txn);
-    active_set_mutex_.Unlock();
-    bool isvalid = SerialValidate(txn);
+    set<Txn*> finish;
+    EnterActiveSet(txn, &finish);
+    bool isvalid = SerialValidate(txn) && !ConflictsWithActive(txn, finish);
+    UnpinActive(finish);
     if(isvalid) {
-        set<Key> interset;
-        for (set<Key>::iterator it2 = txn->readset_.begin(); it2 != txn->readset_.end(); ++it2)
-        {
-            interset.insert(*it2);
-        }
-        for (set<Key>::iterator it3 = txn->writeset_.begin(); it3 != txn->writeset_.end(); ++it3)
-        {
-            interset.insert(*it3);
-        }
-        for (set<Txn*>::iterator it = finish.begin(); it != finish.end() && isvalid; ++it)
-        {
-            Txn* past_txn = *it;
-            for (set<Key>::iterator it1 = past_txn->writeset_.begin(); it1 != past_txn->writeset_.end() && isvalid; ++it1){
-
-                for (set<Key>::iterator it2 = interset.begin(); it2 != interset.end(); ++it2)
-                {
-                    if(*it1 == *it2) {
-                        isvalid = false;
-                        break;
-                    }
-                }
-            }
-        }
-    }
-    if(isvalid) {
-        ApplyWrites(txn);
-        txn->status_ = COMMITTED;
-        txn_results_.Push(txn);
-        committed_txns_.Push(txn);
+        CommitOrAbortTxn(txn);
+        // Leave the active set before handing the txn back: the client may
+        // delete it as soon as it is in 'txn_results_'.
+        LeaveActiveSet(txn);
+        ReturnResult(txn);
     } else {
+        LeaveActiveSet(txn);
         txn->reads_.clear();
         txn->writes_.clear();
         txn->status_ = INCOMPLETE;
         mutex_.Lock();
         txn->unique_id_ = next_unique_id_;
         next_unique_id_++;
-        txn_requests_.Push(txn);
+        EnqueueRequest(txn);
         mutex_.Unlock();
     }
+    finish.clear();
+}
+
+bool TxnProcessor::ConflictsWithActive(Txn* txn, const set<Txn*>& active)
+{
+    for (set<Txn*>::const_iterator it = active.begin(); it != active.end(); ++it)
+    {
+        Txn* other = *it;
+        // Only compare keys if the signatures overlap.
+        if (!other->writeset_sig_.Intersects(txn->readset_sig_) && !other->writeset_sig_.Intersects(txn->writeset_sig_))
+            continue;
+        if (SortedKeysIntersect(other->writeset_, txn->readset_) || SortedKeysIntersect(other->writeset_, txn->writeset_))
+            return true;
+    }
+    return false;
+}
+
+void TxnProcessor::EnterActiveSet(Txn* txn, set<Txn*>* active)
+{
+    // Pinned under the latch: a txn that left the set can't be pinned again.
+    active_set_mutex_.Lock();
+    *active = active_set_.GetSet();
+    for (set<Txn*>::iterator it = active->begin(); it != active->end(); ++it) (*it)->occ_pins_.fetch_add(1);
+    active_set_.Insert(txn);
+    active_set_mutex_.Unlock();
+}
+
+void TxnProcessor::UnpinActive(const set<Txn*>& active)
+{
+    for (set<Txn*>::const_iterator it = active.begin(); it != active.end(); ++it) (*it)->occ_pins_.fetch_sub(1);
+}
+
+void TxnProcessor::LeaveActiveSet(Txn* txn)
+{
     active_set_mutex_.Lock();
     active_set_.Erase(txn);
     active_set_mutex_.Unlock();
-    finish.clear();
+
+    // Pins only last for a validation (which never waits), so this is short.
+    while (txn->occ_pins_.load() != 0) sched_yield();
 }
 
 bool TxnProcessor::SerialValidate(Txn* txn) {
@@ -581,15 +968,19 @@ bool TxnProcessor::SerialValidate(Txn* txn) {
 }
 
 void TxnProcessor::MVCCMVTOExecuteTxn(Txn* txn) {
-    for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
     {
         // Save each read result iff record exists in storage.
         Value result;
-        storage_->Lock(*it);
         if (storage_->Read(*it, &result,txn->unique_id_)) {
             txn->reads_[*it] = result;
         }
-        storage_->Unlock(*it);
+    }
+    // Also read everything in from writeset.
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    {
+        Value result;
+        if (storage_->Read(*it, &result, txn->unique_id_)) txn->reads_[*it] = result;
     }
     txn->Run();
     MVCCLockWriteKeys(txn);
@@ -597,19 +988,22 @@ void TxnProcessor::MVCCMVTOExecuteTxn(Txn* txn) {
     if(isvalid) {
         ApplyWrites(txn);
         MVCCUnlockWriteKeys(txn);
+        epochs_.Exit(txn->gc_epoch_);
         txn->status_ = COMMITTED;
-        txn_results_.Push(txn);
-        committed_txns_.Push(txn);
+        ReturnResult(txn);
        
     } else {
         MVCCUnlockWriteKeys(txn);
+        // The restarted txn gets a new, larger timestamp below and registers
+        // again when it is dispatched.
+        epochs_.Exit(txn->gc_epoch_);
         txn->reads_.clear();
         txn->writes_.clear();
         txn->status_ = INCOMPLETE;
         mutex_.Lock();
         txn->unique_id_ = next_unique_id_;
         next_unique_id_++;
-        txn_requests_.Push(txn);
+        EnqueueRequest(txn);
         mutex_.Unlock();
     }
 }
@@ -617,7 +1011,7 @@ void TxnProcessor::MVCCMVTOExecuteTxn(Txn* txn) {
 bool TxnProcessor::MVCCCheckWrites(Txn* txn) {
 
     bool isvalid = true;
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end() && isvalid; ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end() && isvalid; ++it)
     {
         isvalid = storage_->CheckWrite(*it,txn->unique_id_);
     }
@@ -625,111 +1019,605 @@ bool TxnProcessor::MVCCCheckWrites(Txn* txn) {
 }
 
 void TxnProcessor::MVCCLockWriteKeys(Txn* txn) {
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
     {
         storage_->Lock(*it);
     }
 }
 
 void TxnProcessor::MVCCUnlockWriteKeys(Txn* txn) {
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
     {
         storage_->Unlock(*it);
     }
 }
 
+void TxnProcessor::LockFreeMVTOExecuteTxn(Txn* txn)
+{
+    LockFreeMVCCStorage* storage = static_cast<LockFreeMVCCStorage*>(storage_);
+    int ts                       = txn->unique_id_;
+    bool valid                   = true;
 
-void TxnProcessor::RunMVCCMV2PLScheduler() {
+    // Read everything in from readset and writeset. A read only fails if a
+    // write it might have to see is still pending.
+    for (int pass = 0; pass < 2 && valid; pass++)
+    {
+        KeySet& keys = (pass == 0) ? txn->readset_ : txn->writeset_;
+        for (KeySet::iterator it = keys.begin(); it != keys.end() && valid; ++it)
+        {
+            Value result;
+            LockFreeMVCCStorage::ReadResult read = storage->TryRead(*it, ts, &result);
+            if (read == LockFreeMVCCStorage::READ_OK)
+                txn->reads_[*it] = result;
+            else if (read == LockFreeMVCCStorage::READ_CONFLICT)
+                valid = false;
+        }
+    }
+
+    if (valid) txn->Run();
+
+    // Install all writes as pending versions, then check that no newer txn
+    // read any of the versions they replace.
+    vector<AtomicVersion*> installed;
+    if (valid && txn->Status() == COMPLETED_C)
+    {
+        for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end() && valid; ++it)
+        {
+            AtomicVersion* version = storage->Install(it->first, it->second, ts);
+            if (version == NULL)
+                valid = false;
+            else
+                installed.push_back(version);
+        }
+        for (uint32 i = 0; i < installed.size() && valid; i++) valid = storage->Validate(installed[i]);
+    }
+    for (uint32 i = 0; i < installed.size(); i++)
+    {
+        if (valid)
+            storage->Commit(installed[i]);
+        else
+            storage->Abort(installed[i]);
+    }
+    epochs_.Exit(txn->gc_epoch_);
+
+    if (valid)
+    {
+        txn->status_ = (txn->Status() == COMPLETED_C) ? COMMITTED : ABORTED;
+        ReturnResult(txn);
+    }
+    else
+    {
+        // Restart with a new, larger timestamp.
+        txn->reads_.clear();
+        txn->writes_.clear();
+        txn->status_ = INCOMPLETE;
+        mutex_.Lock();
+        txn->unique_id_ = next_unique_id_;
+        next_unique_id_++;
+        EnqueueRequest(txn);
+        mutex_.Unlock();
+    }
+}
+
+void TxnProcessor::RunSSIScheduler()
+{
     Txn* txn;
     while (!stopped_)
     {
-        // Start processing the next incoming transaction request.
         if (txn_requests_.Pop(&txn))
         {
-            
-            bool blocked = false;
-            // Request read locks.
-            for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
-            {
-                if (!lm_->ReadLock(txn, *it))
-                {
-                    blocked = true;
-                }
-            }
+            // Snapshots never decrease, so they are entered in order, as
+            // EpochManager requires.
+            txn->snapshot_ts_ = ssi_->Snapshot();
+            txn->gc_epoch_    = snapshots_.Enter(txn->snapshot_ts_);
+            tp_.AddTask([this, txn]() { this->SSIExecuteTxn(txn); });
+        }
 
-            // Request write locks.
-            for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
-            {
-                if (!lm_->WriteLock(txn, *it)) {
-                    blocked = true;
-                }
-            }
+        WaitForSchedulerWork();
+    }
+}
 
-            // If all read and write locks were immediately acquired, this txn is
-            // ready to be executed.
-            if (blocked == false)
-            {
-                ready_txns_.push_back(txn);
-            }
+void TxnProcessor::SSIExecuteTxn(Txn* txn)
+{
+    SSITxn* attempt = ssi_->Begin(txn->snapshot_ts_);
+
+    // Read everything in from readset and writeset, as of the snapshot.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        KeySet& keys = (pass == 0) ? txn->readset_ : txn->writeset_;
+        for (KeySet::iterator it = keys.begin(); it != keys.end(); ++it)
+        {
+            Value result;
+            if (ssi_->Read(attempt, *it, &result)) txn->reads_[*it] = result;
         }
+    }
 
-         // Process and commit all transactions that have finished running.
-        while (completed_txns_.Pop(&txn))
+    txn->Run();
+
+    bool valid = true;
+    if (txn->Status() == COMPLETED_C)
+        valid = ssi_->Commit(attempt, txn->readset_, txn->writeset_, txn->writes_);
+    else
+        ssi_->Abort(attempt);
+    snapshots_.Exit(txn->gc_epoch_);
+
+    if (valid)
+    {
+        txn->status_ = (txn->Status() == COMPLETED_C) ? COMMITTED : ABORTED;
+        ReturnResult(txn);
+    }
+    else
+    {
+        // Restart against a newer snapshot.
+        txn->reads_.clear();
+        txn->writes_.clear();
+        txn->status_ = INCOMPLETE;
+        mutex_.Lock();
+        txn->unique_id_ = next_unique_id_;
+        next_unique_id_++;
+        EnqueueRequest(txn);
+        mutex_.Unlock();
+    }
+}
+
+void TxnProcessor::RunSiloScheduler()
+{
+    Txn* txn;
+    while (!stopped_)
+    {
+        if (txn_requests_.Pop(&txn))
         {
-            // Release read locks.
-            for (set<Key>::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+            if (mode_ == OCC_TICTOC)
+                tp_.AddTask([this, txn]() { this->TicTocExecuteTxn(txn); });
+            else
+                tp_.AddTask([this, txn]() { this->SiloExecuteTxn(txn); });
+        }
+
+        WaitForSchedulerWork();
+    }
+}
+
+void TxnProcessor::SiloExecuteTxn(Txn* txn)
+{
+    SiloStorage* storage = static_cast<SiloStorage*>(storage_);
+    vector<pair<SiloStorage::Record*, uint64> > reads;  // Records read, with the TIDs seen
+    vector<SiloStorage::Record*> writes;                // Records written, in key order
+
+    while (true)
+    {
+        // Read everything in from readset and writeset.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            KeySet& keys = (pass == 0) ? txn->readset_ : txn->writeset_;
+            for (KeySet::iterator it = keys.begin(); it != keys.end(); ++it)
             {
-                lm_->Release(txn, *it);
+                SiloStorage::Record* record = storage->RecordFor(*it);
+                Value result;
+                uint64 tid;
+                if (SiloStorage::StableRead(record, &result, &tid)) txn->reads_[*it] = result;
+                reads.push_back(make_pair(record, tid));
             }
-            // Release write locks.
-            for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+        }
+
+        txn->Run();
+        if (txn->Status() == COMPLETED_A)
+        {
+            txn->status_ = ABORTED;
+            break;
+        }
+
+        // Phase 1: lock the write set. 'writes_' is ordered by key, so two
+        // committers never wait for each other in a cycle.
+        for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it)
+        {
+            SiloStorage::Record* record = storage->RecordFor(it->first);
+            SiloStorage::Lock(record);
+            writes.push_back(record);
+        }
+
+        // Serialization point: the epoch the txn commits in.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64 epoch = silo_epoch_.load();
+
+        // Phase 2: every record read must still have the TID it was read with,
+        // and must not be locked by another committer.
+        bool valid = true;
+        uint64 tid = 0;
+        for (uint32 i = 0; i < reads.size() && valid; i++)
+        {
+            uint64 current = reads[i].first->tid_.load();
+            bool locked    = (current & SiloStorage::kLockBit) &&
+                          find(writes.begin(), writes.end(), reads[i].first) == writes.end();
+            valid = !locked && (current & ~SiloStorage::kLockBit) == reads[i].second;
+            tid   = max(tid, reads[i].second);
+        }
+
+        if (valid)
+        {
+            // Phase 3: the commit TID is larger than that of every record read
+            // or written, and in the current epoch.
+            for (uint32 i = 0; i < writes.size(); i++) tid = max(tid, writes[i]->tid_.load());
+            tid = max((tid & ~SiloStorage::kStatusBits) + SiloStorage::kSequenceUnit, SiloStorage::EpochTID(epoch));
+            uint32 i = 0;
+            for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it, ++i)
+                SiloStorage::Install(writes[i], it->second, tid);
+            txn->status_ = COMMITTED;
+            break;
+        }
+
+        // Restart in place.
+        for (uint32 i = 0; i < writes.size(); i++) SiloStorage::Unlock(writes[i]);
+        reads.clear();
+        writes.clear();
+        txn->reads_.clear();
+        txn->writes_.clear();
+        txn->status_ = INCOMPLETE;
+    }
+
+    ReturnResult(txn);
+}
+
+void TxnProcessor::TicTocExecuteTxn(Txn* txn)
+{
+    TicTocStorage* storage = static_cast<TicTocStorage*>(storage_);
+    vector<pair<TicTocStorage::Record*, uint64> > reads;  // Records read, with the words seen
+    vector<TicTocStorage::Record*> writes;                // Records written, in key order
+
+    while (true)
+    {
+        // Read everything in from readset and writeset.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            KeySet& keys = (pass == 0) ? txn->readset_ : txn->writeset_;
+            for (KeySet::iterator it = keys.begin(); it != keys.end(); ++it)
             {
-                lm_->Release(txn, *it);
+                TicTocStorage::Record* record = storage->RecordFor(*it);
+                Value result;
+                uint64 word;
+                if (TicTocStorage::StableRead(record, &result, &word)) txn->reads_[*it] = result;
+                reads.push_back(make_pair(record, word));
             }
-            txn_results_.Push(txn);
         }
 
-        while (ready_txns_.size())
+        txn->Run();
+        if (txn->Status() == COMPLETED_A)
+        {
+            txn->status_ = ABORTED;
+            break;
+        }
+
+        // Phase 1: lock the write set. 'writes_' is ordered by key, so two
+        // committers never wait for each other in a cycle.
+        for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it)
+        {
+            TicTocStorage::Record* record = storage->RecordFor(it->first);
+            TicTocStorage::Lock(record);
+            writes.push_back(record);
+        }
+
+        // Phase 2: the commit timestamp is the earliest logical time at which
+        // every value read was still current and every record written can be
+        // overwritten without invalidating reads already made of it.
+        uint64 ts = 0;
+        for (uint32 i = 0; i < writes.size(); i++)
+            ts = max(ts, TicTocStorage::RTS(writes[i]->word_.load()) + 1);
+        for (uint32 i = 0; i < reads.size(); i++) ts = max(ts, TicTocStorage::WTS(reads[i].second));
+
+        // Phase 3: every value read must still be current at 'ts'.
+        bool valid = true;
+        for (uint32 i = 0; i < reads.size() && valid; i++)
+        {
+            if (TicTocStorage::RTS(reads[i].second) >= ts) continue;
+            bool locked_by_caller = find(writes.begin(), writes.end(), reads[i].first) != writes.end();
+            valid = TicTocStorage::ValidateRead(reads[i].first, reads[i].second, ts, locked_by_caller);
+        }
+
+        if (valid)
         {
-            // Get next ready txn from the queue.
-            txn = ready_txns_.front();
-            ready_txns_.pop_front();
-            // Start txn running in its own thread.
-            tp_.AddTask([this, txn]() { this->MVCC2PLExecuteTxn(txn);});
+            uint32 i = 0;
+            for (KeyValueMap::iterator it = txn->writes_.begin(); it != txn->writes_.end(); ++it, ++i)
+                TicTocStorage::Install(writes[i], it->second, ts);
+            txn->status_ = COMMITTED;
+            break;
         }
+
+        // Restart in place.
+        for (uint32 i = 0; i < writes.size(); i++) TicTocStorage::Unlock(writes[i]);
+        reads.clear();
+        writes.clear();
+        txn->reads_.clear();
+        txn->writes_.clear();
+        txn->status_ = INCOMPLETE;
     }
+
+    ReturnResult(txn);
 }
 
+void* TxnProcessor::StartSiloEpochAdvancer(void* arg)
+{
+    TxnProcessor* processor = reinterpret_cast<TxnProcessor*>(arg);
+    PlaceCurrentThread(ThreadPlacement(processor->options_, -1), 0);
+    while (!processor->stopped_)
+    {
+        usleep(SILO_EPOCH_INTERVAL_US);
+        processor->silo_epoch_.fetch_add(1);
+    }
+    return NULL;
+}
 
 void TxnProcessor::MVCC2PLExecuteTxn(Txn* txn) {
+    // The txn holds its 2PL locks, so the latest versions are the ones to
+    // read.
+    MVCCStorage* storage = static_cast<MVCCStorage*>(storage_);
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+    {
+        Value result;
+        if (storage->SnapshotRead(*it, &result, INT_MAX)) txn->reads_[*it] = result;
+    }
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+    {
+        Value result;
+        if (storage->SnapshotRead(*it, &result, INT_MAX)) txn->reads_[*it] = result;
+    }
     txn->Run();
     MVCCLockWriteKeys(txn);
-    bool isvalid = true;
-    if(isvalid) {
-        ApplyWrites(txn);
-        MVCCUnlockWriteKeys(txn);
-        txn->status_ = COMMITTED;
-        committed_txns_.Push(txn);
-        completed_txns_.Push(txn);
-    } else {
-        MVCCUnlockWriteKeys(txn);
-        txn->reads_.clear();
-        txn->writes_.clear();
-        txn->status_ = INCOMPLETE;
-        mutex_.Lock();
-        txn->unique_id_ = next_unique_id_;
-        next_unique_id_++;
-        txn_requests_.Push(txn);
-        mutex_.Unlock();
-    }
+    CommitOrAbortTxn(txn);
+    MVCCUnlockWriteKeys(txn);
 }
 
 
 bool TxnProcessor::MVCC2PLCheckWrites(Txn* txn) {
     bool isvalid = true;
-    for (set<Key>::iterator it = txn->writeset_.begin(); it != txn->writeset_.end() && isvalid; ++it)
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end() && isvalid; ++it)
     {
         isvalid = storage_->CheckWrite1(*it,txn->unique_id_);
     }
     return isvalid;
-}
\ No newline at end of file
+}
+
+void* TxnProcessor::StartGarbageCollector(void* arg)
+{
+    TxnProcessor* processor = reinterpret_cast<TxnProcessor*>(arg);
+    PlaceCurrentThread(ThreadPlacement(processor->options_, -1), 0);
+    while (!processor->stopped_)
+    {
+        processor->GarbageCollection();
+        usleep(GC_STEP_INTERVAL_US);
+    }
+    return NULL;
+}
+
+void TxnProcessor::GarbageCollection()
+{
+    // MV2PL txns only ever see the latest version (they hold 2PL locks), so
+    // every older version is garbage as soon as it is superseded.
+    int low_watermark = INT_MAX;
+    if (mode_ == MVCC_SSI)
+    {
+        // Snapshots are registered in dispatch order, and never decrease.
+        snapshots_.Advance();
+        low_watermark = snapshots_.LowWatermark() - 1;
+        ssi_->CollectGarbage(low_watermark);
+    }
+    else if (mode_ != MVCC_MV2PL)
+    {
+        epochs_.Advance();
+        snapshots_.Advance();
+        // Read-only txns pick their snapshot under 'mutex_' (see
+        // NewTxnRequest()). Taking it here too means that any of them not yet
+        // registered in 'snapshots_' below will pick one >= watermark - 1.
+        mutex_.Lock();
+        int watermark = epochs_.LowWatermark();
+        mutex_.Unlock();
+        low_watermark = snapshots_.OldestActive(watermark - 1);
+    }
+    if (mode_ == MVCC_MVTO_LOCK_FREE)
+        static_cast<LockFreeMVCCStorage*>(storage_)->CollectGarbage(low_watermark, GC_PARTITIONS_PER_STEP);
+    else
+        static_cast<MVCCStorage*>(storage_)->CollectGarbage(low_watermark, GC_PARTITIONS_PER_STEP);
+}
+
+GCStats TxnProcessor::GarbageCollectionStats()
+{
+    if (mode_ == MVCC_MVTO_LOCK_FREE) return static_cast<LockFreeMVCCStorage*>(storage_)->Stats();
+    if (MVCCMode()) return static_cast<MVCCStorage*>(storage_)->Stats();
+    GCStats stats = {0, 0, 0, 0};
+    return stats;
+}
+
+// Bit of 'key' in the VLL key filters.
+static inline uint64 VllFilterBit(Key key) { return (HashKey(key) >> 32) & (VLL_FILTER_BITS - 1); }
+
+static inline bool VllFilterTest(const vector<uint64>& filter, Key key)
+{
+    uint64 bit = VllFilterBit(key);
+    return (filter[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline void VllFilterSet(vector<uint64>* filter, Key key)
+{
+    uint64 bit = VllFilterBit(key);
+    (*filter)[bit / 64] |= 1ULL << (bit % 64);
+}
+
+void TxnProcessor::RunVllScheduler()
+{
+    VllStorage* storage = static_cast<VllStorage*>(storage_);
+    Txn* txn;
+    while (!stopped_)
+    {
+        // Admit new txns. Every lock request just bumps a counter in the
+        // record, so a txn is blocked iff some other admitted, unfinished
+        // txn conflicts with it.
+        while (vll_queue_.size() < VLL_MAX_ADMITTED_TXNS && txn_requests_.Pop(&txn))
+        {
+            bool free = true;
+            for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+                if (!VllStorage::LockExclusive(storage->RecordFor(*it))) free = false;
+            // A key both read and written only takes the exclusive lock (the
+            // shared one would block the txn on itself).
+            for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+                if (txn->writeset_.count(*it) == 0 && !VllStorage::LockShared(storage->RecordFor(*it))) free = false;
+
+            txn->vll_slot_ = vll_front_ + vll_queue_.size();
+            VllEntry entry = {txn, !free, false};
+            vll_queue_.push_back(entry);
+            if (free)
+                tp_.AddTask([this, txn]() { this->VllExecuteTxn(txn); });
+            else
+                vll_blocked_++;
+        }
+
+        // Return the results of finished txns (which released their locks
+        // already).
+        bool finished = false;
+        while (PopCompletedTxn(&txn))
+        {
+            vll_queue_[txn->vll_slot_ - vll_front_].done = true;
+            ReturnResult(txn);
+            finished = true;
+        }
+
+        // Only a finished txn can unblock others.
+        if (finished)
+        {
+            while (!vll_queue_.empty() && vll_queue_.front().done)
+            {
+                vll_queue_.pop_front();
+                vll_front_++;
+            }
+
+            // Everything admitted before the oldest txn has finished, so it
+            // holds all its locks.
+            if (!vll_queue_.empty() && vll_queue_.front().blocked)
+            {
+                vll_queue_.front().blocked = false;
+                vll_blocked_--;
+                Txn* oldest = vll_queue_.front().txn;
+                tp_.AddTask([this, oldest]() { this->VllExecuteTxn(oldest); });
+            }
+
+            // Look further only when admissions no longer keep the workers
+            // busy.
+            bool admitting = txn_requests_.Size() > 0 && vll_queue_.size() < VLL_MAX_ADMITTED_TXNS;
+            if (vll_blocked_ > 0 && (!admitting || vll_blocked_ >= VLL_ANALYSIS_BLOCKED_TXNS))
+                VllFindRunnable();
+        }
+
+        WaitForSchedulerWork();
+    }
+}
+
+void TxnProcessor::VllFindRunnable()
+{
+    std::fill(vll_exclusive_.begin(), vll_exclusive_.end(), 0);
+    std::fill(vll_shared_.begin(), vll_shared_.end(), 0);
+
+    int blocked = vll_blocked_;
+    for (deque<VllEntry>::iterator entry = vll_queue_.begin(); entry != vll_queue_.end() && blocked > 0; ++entry)
+    {
+        if (entry->done) continue;
+        Txn* txn = entry->txn;
+
+        // A blocked txn only waits for the txns ahead of it: the ones behind
+        // that conflict with it are blocked by its counters.
+        bool runnable = entry->blocked;
+        if (entry->blocked)
+        {
+            blocked--;
+            for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end() && runnable; ++it)
+                runnable = !VllFilterTest(vll_exclusive_, *it) && !VllFilterTest(vll_shared_, *it);
+            for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end() && runnable; ++it)
+                runnable = !VllFilterTest(vll_exclusive_, *it);
+        }
+
+        for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+            VllFilterSet(&vll_exclusive_, *it);
+        for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+            VllFilterSet(&vll_shared_, *it);
+
+        if (runnable)
+        {
+            entry->blocked = false;
+            vll_blocked_--;
+            tp_.AddTask([this, txn]() { this->VllExecuteTxn(txn); });
+        }
+    }
+}
+
+void TxnProcessor::VllExecuteTxn(Txn* txn)
+{
+    ReadAndRunTxn(txn);
+    CommitOrAbortTxn(txn);
+
+    VllStorage* storage = static_cast<VllStorage*>(storage_);
+    for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+        VllStorage::UnlockExclusive(storage->RecordFor(*it));
+    for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+        if (txn->writeset_.count(*it) == 0) VllStorage::UnlockShared(storage->RecordFor(*it));
+
+    CompleteTxn(txn);
+}
+
+void TxnProcessor::RunCalvinScheduler()
+{
+    vector<Txn*> epoch;
+    epoch.reserve(CALVIN_EPOCH_TXNS);
+    double epoch_start = 0;
+    Txn* txn;
+    while (!stopped_)
+    {
+        while (epoch.size() < CALVIN_EPOCH_TXNS && txn_requests_.Pop(&txn))
+        {
+            if (epoch.empty()) epoch_start = GetTime();
+            epoch.push_back(txn);
+        }
+
+        if (epoch.empty())
+        {
+            WaitForSchedulerWork();
+            continue;
+        }
+
+        // Waiting any longer for txns to join the epoch would leave the
+        // workers idle.
+        if (epoch.size() == CALVIN_EPOCH_TXNS || calvin_running_.load() == 0 ||
+            GetTime() >= epoch_start + CALVIN_EPOCH_US / 1e6)
+        {
+            CalvinLockEpoch(epoch);
+            epoch.clear();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+void TxnProcessor::CalvinLockEpoch(const vector<Txn*>& epoch)
+{
+    // Counted first: a txn may finish before the epoch is through.
+    calvin_running_.fetch_add(epoch.size());
+
+    for (uint32 i = 0; i < epoch.size(); i++)
+    {
+        Txn* txn = epoch[i];
+        lm_->BeginRequests(&txn->lock_owner_);
+        // A key both read and written only needs the write lock (a read lock
+        // on it would keep the txn waiting for itself).
+        for (KeySet::iterator it = txn->readset_.begin(); it != txn->readset_.end(); ++it)
+            if (txn->writeset_.count(*it) == 0) lm_->ReadLock(&txn->lock_owner_, *it);
+        for (KeySet::iterator it = txn->writeset_.begin(); it != txn->writeset_.end(); ++it)
+            lm_->WriteLock(&txn->lock_owner_, *it);
+        if (lm_->EndRequests(&txn->lock_owner_)) tp_.AddTask([this, txn]() { this->CalvinExecuteTxn(txn); });
+    }
+}
+
+void TxnProcessor::CalvinExecuteTxn(Txn* txn)
+{
+    ReadAndRunTxn(txn);
+    CommitOrAbortTxn(txn);
+    lm_->ReleaseAll(&txn->lock_owner_);
+    calvin_running_.fetch_sub(1);
+    ReturnResult(txn);
+}
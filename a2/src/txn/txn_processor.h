@@ -5,14 +5,23 @@
 #include <map>
 #include <string>
 
+#include "commit_log.h"
+#include "lock_free_mvcc_storage.h"
 #include "lock_manager.h"
 #include "mvcc_storage.h"
+#include "silo_storage.h"
+#include "ssi_manager.h"
 #include "storage.h"
+#include "tictoc_storage.h"
 #include "txn.h"
+#include "vll_storage.h"
 #include "utils/atomic.h"
 #include "utils/common.h"
+#include "utils/epoch_manager.h"
+#include "utils/event_count.h"
+#include "utils/lock_free_queue.h"
 #include "utils/mutex.h"
-#include "utils/static_thread_pool.h"
+#include "utils/work_stealing_thread_pool.h"
 
 using std::deque;
 using std::map;
@@ -31,17 +40,57 @@ enum CCMode
     OCC_PARREL_BACKWARD_VALIDATION = 6,
     MVCC_MVTO                   = 7,
     MVCC_MV2PL                   = 8,  
+    MVCC_MVTO_LOCK_FREE          = 9,  // MVTO without locks (LockFreeMVCCStorage)
+    MVCC_SSI                     = 10, // Serializable snapshot isolation (SSIManager)
+    OCC_SILO                     = 11, // Silo-style OCC: per-record TIDs, no global critical section
+    OCC_TICTOC                   = 12, // TicToc OCC: commit timestamps derived from per-record wts/rts
+    VLL                          = 13, // Very lightweight locking: per-record lock counters (VllStorage)
+    CALVIN                       = 14, // Deterministic batches: locks for a whole epoch taken in one pass
+    LOCKING_WAIT_DIE             = 15, // 2PL, locks in no global order, deadlocks prevented by wait-die
+    LOCKING_WOUND_WAIT           = 16, // Same, by wound-wait
+};
+
+// Layout of the plain single-version storage (see TxnProcessor()).
+enum StorageLayout
+{
+    HASHED_STORAGE = 0,  // Records in hash tables (ShardedStorage, or Storage for SERIAL)
+    DENSE_STORAGE  = 1,  // Records in an array indexed by key (DenseStorage)
 };
 
 // Returns a human-readable string naming of the providing mode.
 string ModeToString(CCMode mode);
 
+// Threads and placement of a TxnProcessor. By default nothing is pinned and
+// memory comes from wherever the OS puts it.
+struct TxnProcessorOptions
+{
+    TxnProcessorOptions() : worker_count(8), scheduler_core(-1), numa_node(-1) {}
+
+    // Number of worker threads.
+    int worker_count;
+
+    // CPU the scheduler thread is pinned to (-1: not pinned to one CPU).
+    int scheduler_core;
+
+    // CPUs the workers are pinned to, worker i to worker_cores[i % size()]
+    // (empty: not pinned to single CPUs). Should not include scheduler_core.
+    vector<int> worker_cores;
+
+    // NUMA node to bind to (-1: none). Threads not pinned to a CPU above run
+    // on the node's CPUs, and the storage and per-worker structures are
+    // allocated on the node.
+    int numa_node;
+};
+
 class TxnProcessor
 {
    public:
     // The TxnProcessor's constructor starts the TxnProcessor running in the
-    // background.
-    explicit TxnProcessor(CCMode mode);
+    // background. Only the modes that use the plain single-version storage
+    // (SERIAL, the LOCKING and OCC_SERIAL/OCC_PARREL modes, and CALVIN) take
+    // DENSE_STORAGE; the others die if given it.
+    explicit TxnProcessor(CCMode mode, StorageLayout layout = HASHED_STORAGE,
+                          const TxnProcessorOptions& options = TxnProcessorOptions());
 
     // The TxnProcessor's destructor stops all background threads and deallocates
     // all objects currently owned by the TxnProcessor, except for Txn objects.
@@ -55,6 +104,38 @@ class TxnProcessor
     // ownership of the returned Txn.
     Txn* GetTxnResult();
 
+    // Hands a txn returned by GetTxnResult() back to the TxnProcessor for
+    // reuse, instead of deleting it. Recycled txns still unused when the
+    // TxnProcessor is destroyed are deleted with it.
+    void RecycleTxn(Txn* txn);
+
+    // Returns a recycled txn of type T, reset to the state of a new txn (no
+    // keys, buffers or status) but keeping the memory of its buffers, or NULL
+    // if there is none. Meant for clients that submit txns of a single type: a
+    // recycled txn of another type is deleted.
+    template <typename T>
+    T* ReuseTxn()
+    {
+        Txn* txn = NULL;
+        recycled_txns_mutex_.Lock();
+        if (!recycled_txns_.empty())
+        {
+            txn = recycled_txns_.back();
+            recycled_txns_.pop_back();
+        }
+        recycled_txns_mutex_.Unlock();
+        if (txn == NULL) return NULL;
+
+        T* reused = dynamic_cast<T*>(txn);
+        if (reused == NULL)
+        {
+            delete txn;
+            return NULL;
+        }
+        txn->Reset();
+        return reused;
+    }
+
     vector<Txn*> GetTxnVectorResults();
 
     // Main loop implementing all concurrency control/thread scheduling.
@@ -62,11 +143,28 @@ class TxnProcessor
 
     static void* StartScheduler(void* arg);
 
-    
+    // Returns the MVCC garbage collection counters (all zero in non-MVCC
+    // modes).
+    GCStats GarbageCollectionStats();
+
    private:
     // Serial validation
     bool SerialValidate(Txn* txn);
 
+    // Returns true if a txn in 'active' writes a key 'txn' reads or writes.
+    bool ConflictsWithActive(Txn* txn, const set<Txn*>& active);
+
+    // Adds 'txn' to the active set of the parallel OCC modes, and sets
+    // '*active' to the txns that were in it. Each of them is pinned (it
+    // cannot be handed back, and so recycled or deleted, while 'txn' reads
+    // its key sets) until UnpinActive(*active).
+    void EnterActiveSet(Txn* txn, set<Txn*>* active);
+    void UnpinActive(const set<Txn*>& active);
+
+    // Removes 'txn' from the active set, and waits until no validator has it
+    // pinned.
+    void LeaveActiveSet(Txn* txn);
+
     // Parallel execution/validation for OCC
     void ExecuteTxnParallelBackwardValidation(Txn* txn);
 
@@ -99,17 +197,89 @@ class TxnProcessor
     // MVCC version of scheduler.
     void RunMVCCMVTOScheduler();
 
+    // Performs all reads required to execute the transaction, executes the
+    // transaction logic, and hands the txn back to the scheduler.
+    void ExecuteTxn(Txn* txn);
+
     // Performs all reads required to execute the transaction, then executes the
     // transaction logic.
-    void ExecuteTxn(Txn* txn);
+    void ReadAndRunTxn(Txn* txn);
+
+    // Runs a txn of the locking modes (and MVCC_MV2PL) in a worker thread:
+    // acquires its locks, executes and commits it, releases the locks and
+    // returns the result. Rerun by the lock manager, from where it left off,
+    // whenever a lock it blocked on is granted (or, in LOCKING_WAIT_DIE and
+    // LOCKING_WOUND_WAIT, once it was chosen as a deadlock victim).
+    void LockingExecuteTxn(Txn* txn);
+
+    // Request the locks of 'txn' not requested yet, and return true once it
+    // holds them all, or false if it blocked (or restarted). In key order,
+    // or, in LOCKING_WAIT_DIE and LOCKING_WOUND_WAIT, in no global order,
+    // write locks first.
+    bool RequestLocksInKeyOrder(Txn* txn);
+    bool RequestLocksUnordered(Txn* txn);
+
+    // Releases the locks of a deadlock victim and resubmits it with a new
+    // unique_id_ (it keeps its lock timestamp, so it ages).
+    void RestartLockingTxn(Txn* txn);
+
+    // Calvin version of scheduler. Collects txns into epochs (closed after
+    // CALVIN_EPOCH_US, after CALVIN_EPOCH_TXNS txns, or as soon as no txn is
+    // running), and passes each epoch to CalvinLockEpoch().
+    void RunCalvinScheduler();
+
+    // Requests the locks of every txn of 'epoch', in order, and dispatches
+    // the txns that got them all; the lock manager dispatches the others as
+    // their locks are granted. Since one thread requests all locks, in one
+    // global order, there are no deadlocks, and no txn is ever aborted.
+    void CalvinLockEpoch(const vector<Txn*>& epoch);
+
+    // Executes and commits a txn holding all its locks, releases them and
+    // returns the result.
+    void CalvinExecuteTxn(Txn* txn);
+
+    // Commits a txn executed by ReadAndRunTxn() (holding all its locks)
+    // that voted to commit, or aborts it.
+    void CommitOrAbortTxn(Txn* txn);
+
+    // Runs a read-only txn, in a worker thread, without involving the
+    // scheduler: it reads a consistent snapshot, takes no locks, is never
+    // validated and writes no metadata, so it never delays or aborts anyone.
+    // On single-version storage, a txn whose reads keep overlapping commits
+    // goes through the scheduler after all.
+    void ExecuteReadOnlyTxn(Txn* txn);
+
+    // Sets '*applied' to the number of ApplyWrites() calls completed and
+    // returns true, or returns false if any is in progress.
+    bool SettledApplyCount(uint64* applied);
 
 
     bool MVCC2PLCheckWrites(Txn* txn);
 
-    void RunMVCCMV2PLScheduler();
-
     void MVCC2PLExecuteTxn(Txn* txn);
 
+    // Hands a txn executed by a worker thread back to the scheduler thread.
+    void CompleteTxn(Txn* txn);
+
+    // If some worker handed back a txn, sets '*txn' to it and returns true.
+    // Scheduler thread only.
+    bool PopCompletedTxn(Txn** txn);
+
+    // Queues a txn for the scheduler thread, waking it if it is parked.
+    void EnqueueRequest(Txn* txn);
+
+    // Queues a finished txn for GetTxnResult(), waking a parked caller.
+    void ReturnResult(Txn* txn);
+
+    // True if the scheduler thread has a request, a completed txn or a ready
+    // txn to process. Scheduler thread only.
+    bool HasSchedulerWork();
+
+    // Called by the scheduler thread at the end of every round of its loop.
+    // Returns at once while there is work; once the scheduler has found none
+    // for SCHEDULER_SPIN_ROUNDS rounds, parks it until a request or a
+    // completed txn arrives (or the processor stops).
+    void WaitForSchedulerWork();
 
     // Applies all writes performed by '*txn' to 'storage_'.
     //
@@ -125,13 +295,74 @@ class TxnProcessor
 
     void MVCCUnlockWriteKeys(Txn* txn);
 
+    // Lock-free MVTO: reads, installs and validates against
+    // LockFreeMVCCStorage without taking any lock.
+    void LockFreeMVTOExecuteTxn(Txn* txn);
+
+    // SSI version of scheduler: hands txns their snapshots, in order.
+    void RunSSIScheduler();
+
+    // Reads the txn's snapshot, runs it and commits it through 'ssi_'.
+    void SSIExecuteTxn(Txn* txn);
+
+    // Silo and TicToc version of scheduler: only dispatches txns to workers.
+    void RunSiloScheduler();
+
+    // Runs a txn to completion under Silo's commit protocol (restarting it
+    // in place until it validates): read records with their TIDs, lock the
+    // write set in key order, validate the read set's TIDs, then install the
+    // writes under a fresh TID from the current epoch.
+    void SiloExecuteTxn(Txn* txn);
+
+    static void* StartSiloEpochAdvancer(void* arg);
+
+    // Runs a txn to completion under TicToc's commit protocol (restarting it
+    // in place until it validates): read records with their wts/rts, lock the
+    // write set in key order, compute the commit timestamp from the read and
+    // write sets, extend the rts of the records read up to it, then install
+    // the writes at it. Dispatched by RunSiloScheduler().
+    void TicTocExecuteTxn(Txn* txn);
+
+    // VLL version of scheduler. Admits txns in order, locking their keys by
+    // bumping the counters of their records, and runs those that found all
+    // their locks free. The others wait in 'vll_queue_' until they are the
+    // oldest txn left, or until VllFindRunnable() finds that nothing ahead
+    // of them conflicts with them any more.
+    void RunVllScheduler();
+
+    // Selective contention analysis: walks 'vll_queue_' in order, marking
+    // the keys of each txn in the 'vll_exclusive_' and 'vll_shared_' filters,
+    // and runs each blocked txn whose keys no txn ahead of it has marked.
+    void VllFindRunnable();
+
+    // Executes and commits a txn holding all its VLL locks, then releases
+    // them and hands the txn back to the scheduler.
+    void VllExecuteTxn(Txn* txn);
+
+    // True for the modes whose read-only txns read from timestamp snapshots.
+    bool SnapshotMode() const { return mode_ == MVCC_MVTO || mode_ == MVCC_MVTO_LOCK_FREE; }
+
+    // True for the modes that run on multiversion storage.
+    bool MVCCMode() const
+    {
+        return mode_ == MVCC_MVTO || mode_ == MVCC_MV2PL || mode_ == MVCC_MVTO_LOCK_FREE || mode_ == MVCC_SSI;
+    }
+
+    // Runs one incremental step of MVCC garbage collection: reclaims versions
+    // older than the low-watermark of active txn timestamps in the next few
+    // storage partitions. Called repeatedly by the garbage collector thread.
     void GarbageCollection();
 
+    static void* StartGarbageCollector(void* arg);
+
     // Concurrency control mechanism the TxnProcessor is currently using.
     CCMode mode_;
 
+    // Thread counts and placement.
+    TxnProcessorOptions options_;
+
     // Thread pool managing all threads used by TxnProcessor.
-    StaticThreadPool tp_;
+    WorkStealingThreadPool tp_;
 
     // Data storage used for all modes.
     Storage* storage_;
@@ -141,25 +372,32 @@ class TxnProcessor
     Mutex mutex_;
 
     // Queue of incoming transaction requests.
-    AtomicQueue<Txn*> txn_requests_;
+    SpillQueue<Txn*> txn_requests_;
 
-    // Queue of txns that have acquired all locks and are ready to be executed.
-    //
-    // Does not need to be atomic because RunScheduler is the only thread that
-    // will ever access this queue.
-    deque<Txn*> ready_txns_;
-    
 
-    // Queue of completed (but not yet committed/aborted) transactions.
-    AtomicQueue<Txn*> completed_txns_;
+    // Completed (but not yet committed/aborted) transactions, one queue per
+    // worker thread: each has a single producer (its worker) and a single
+    // consumer (the scheduler thread).
+    SPSCQueue<Txn*>* completed_txns_;
+
+    // Worker queue PopCompletedTxn() looks at first.
+    int completed_cursor_;
 
-    // Vector of committed transactions that are used to check any overlap
-    // during OCC validation phase.
-    AtomicVector<Txn*> committed_txns_;
+    // Rounds the scheduler has found no work in, and where it parks then.
+    // Notified by EnqueueRequest(), CompleteTxn() and the destructor.
+    int scheduler_idle_rounds_;
+    EventCount scheduler_wakeup_;
+
+    // Write sets of the txns committed by the OCC backward validation modes,
+    // which validate against the commits logged since they started.
+    CommitLog commit_log_;
 
     // Queue of transaction results (already committed or aborted) to be returned
     // to client.
-    AtomicQueue<Txn*> txn_results_;
+    SpillQueue<Txn*> txn_results_;
+
+    // Where GetTxnResult() parks. Notified by ReturnResult().
+    EventCount results_ready_;
 
     // Set of transactions that are currently in the process of parallel
     // validation.
@@ -168,15 +406,73 @@ class TxnProcessor
     // Used it for critical section in parallel occ.
     Mutex active_set_mutex_;
 
-    // Lock Manager used for LOCKING concurrency implementations.
+    // Lock Manager used for LOCKING concurrency implementations and CALVIN
+    // (NULL in every other mode). Called by the worker threads.
     LockManager* lm_;
 
+    // Conflict tracking for MVCC_SSI (NULL in every other mode).
+    SSIManager* ssi_;
+
     // Used for stopping the continuous loop that runs in the scheduler thread
     bool stopped_;
 
     // Gives us access to the scheduler thread so that we can wait for it to join later.
     pthread_t scheduler_thread_;
 
+    // Active MVTO txn timestamps, registered by the scheduler on dispatch and
+    // unregistered by workers once the txn commits or is restarted.
+    EpochManager epochs_;
+
+    // Snapshot timestamps of active read-only txns in the MVTO modes
+    // (registered under 'mutex_'), or of all active txns in MVCC_SSI
+    // (registered by the scheduler).
+    EpochManager snapshots_;
+
+    // Number of ApplyWrites() calls in progress, and completed, by one thread
+    // (on its own cache line). Read-only txns on single-version storage use
+    // them to detect reads that overlapped a commit (MVTO modes don't
+    // maintain them).
+    struct alignas(CACHE_LINE_SIZE) ApplyCounter
+    {
+        ApplyCounter() : applying_(0), applied_(0) {}
+        std::atomic<int> applying_;
+        std::atomic<uint64> applied_;
+    };
+
+    // One per worker, and a last one for every other thread.
+    ApplyCounter* apply_counters_;
+
+    // Background thread running GarbageCollection() (MVCC modes only).
+    pthread_t gc_thread_;
+
+    // Txns handed back by RecycleTxn(), in a vector whose capacity persists,
+    // so recycling doesn't allocate in the steady state.
+    vector<Txn*> recycled_txns_;
+    Mutex recycled_txns_mutex_;
+
+    // Current Silo epoch, the high half of every TID committed in it, and the
+    // background thread that advances it (OCC_SILO only).
+    std::atomic<uint64> silo_epoch_;
+    pthread_t silo_epoch_thread_;
+
+    // Number of txns of closed Calvin epochs not yet finished.
+    std::atomic<int> calvin_running_;
+
+    // VLL: every admitted txn whose result was not yet returned, in order of
+    // admission, with whether it is still blocked (its slot in the queue is
+    // Txn::vll_slot_ - 'vll_front_'); the number of blocked ones; and the
+    // filters VllFindRunnable() marks keys in. Scheduler thread only.
+    struct VllEntry
+    {
+        Txn* txn;  // Not to be used once 'done'
+        bool blocked;
+        bool done;
+    };
+    deque<VllEntry> vll_queue_;
+    uint64 vll_front_;
+    int vll_blocked_;
+    vector<uint64> vll_exclusive_;
+    vector<uint64> vll_shared_;
 };
 
 #endif  // _TXN_PROCESSOR_H_
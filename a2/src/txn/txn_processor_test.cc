@@ -28,16 +28,42 @@ string ModeToString(CCMode mode)
             return " MVCC_MVTO  ";
         case MVCC_MV2PL:
             return " MVCC_MV2PL ";
+        case MVCC_MVTO_LOCK_FREE:
+            return " MVCC_MVTO_LF";
+        case MVCC_SSI:
+            return " MVCC_SSI   ";
+        case OCC_SILO:
+            return " OCC_SILO   ";
+        case OCC_TICTOC:
+            return " OCC_TICTOC ";
+        case VLL:
+            return " VLL        ";
+        case CALVIN:
+            return " CALVIN     ";
+        case LOCKING_WAIT_DIE:
+            return " WAIT-DIE   ";
+        case LOCKING_WOUND_WAIT:
+            return " WOUND-WAIT ";
         default:
             return "INVALID MODE";
     }
 }
 
+// Returns a new RMW txn with randomized read/write sets, reusing one
+// recycled to 'p' if there is any.
+RMW* NewRMW(TxnProcessor* p, int dbsize, int readsetsize, int writesetsize, double time)
+{
+    RMW* txn = p->ReuseTxn<RMW>();
+    if (txn == NULL) return new RMW(dbsize, readsetsize, writesetsize, time);
+    txn->Init(dbsize, readsetsize, writesetsize, time);
+    return txn;
+}
+
 class LoadGen
 {
    public:
     virtual ~LoadGen() {}
-    virtual Txn* NewTxn() = 0;
+    virtual Txn* NewTxn(TxnProcessor* p) = 0;
 };
 
 class RMWLoadGen : public LoadGen
@@ -48,7 +74,7 @@ class RMWLoadGen : public LoadGen
     {
     }
 
-    virtual Txn* NewTxn() { return new RMW(dbsize_, rsetsize_, wsetsize_, wait_time_); }
+    virtual Txn* NewTxn(TxnProcessor* p) { return NewRMW(p, dbsize_, rsetsize_, wsetsize_, wait_time_); }
    private:
     int dbsize_;
     int rsetsize_;
@@ -64,15 +90,15 @@ class RMWLoadGen2 : public LoadGen
     {
     }
 
-    virtual Txn* NewTxn()
+    virtual Txn* NewTxn(TxnProcessor* p)
     {
         // 80% of transactions are READ only transactions and run for the full
         // transaction duration. The rest are very fast (< 0.1ms), high-contention
         // updates.
         if (rand() % 100 < 80)
-            return new RMW(dbsize_, rsetsize_, 0, wait_time_);
+            return NewRMW(p, dbsize_, rsetsize_, 0, wait_time_);
         else
-            return new RMW(dbsize_, 0, wsetsize_, 0);
+            return NewRMW(p, dbsize_, 0, wsetsize_, 0);
     }
 
    private:
@@ -92,15 +118,15 @@ class RMWDynLoadGen : public LoadGen
         wait_times_ = wait_times;
     }
 
-    virtual Txn* NewTxn()
+    virtual Txn* NewTxn(TxnProcessor* p)
     {
         // Mix transactions with different time durations (wait_times_) 
         if (rand() % 100 < 30)
-            return new RMW(dbsize_, rsetsize_, wsetsize_, wait_times_[0]);
+            return NewRMW(p, dbsize_, rsetsize_, wsetsize_, wait_times_[0]);
         else if (rand() % 100 < 60)
-            return new RMW(dbsize_, rsetsize_, wsetsize_, wait_times_[1]);
+            return NewRMW(p, dbsize_, rsetsize_, wsetsize_, wait_times_[1]);
         else
-            return new RMW(dbsize_, rsetsize_, wsetsize_, wait_times_[2]);
+            return NewRMW(p, dbsize_, rsetsize_, wsetsize_, wait_times_[2]);
     }
 
    private:
@@ -119,7 +145,7 @@ class RMWDynLoadGen2 : public LoadGen
         wait_times_ = wait_times;
     }
 
-    virtual Txn* NewTxn()
+    virtual Txn* NewTxn(TxnProcessor* p)
     {
         // 80% of transactions are READ only transactions and run for the different
         // transaction duration. The rest are very fast (< 0.1ms), high-contention
@@ -127,13 +153,13 @@ class RMWDynLoadGen2 : public LoadGen
         if (rand() % 100 < 80) {
             // Mix transactions with different time durations (wait_times_) 
             if (rand() % 100 < 30)
-                return new RMW(dbsize_, rsetsize_, 0, wait_times_[0]);
+                return NewRMW(p, dbsize_, rsetsize_, 0, wait_times_[0]);
             else if (rand() % 100 < 60)
-                return new RMW(dbsize_, rsetsize_, 0, wait_times_[1]);
+                return NewRMW(p, dbsize_, rsetsize_, 0, wait_times_[1]);
             else
-                return new RMW(dbsize_, rsetsize_, 0, wait_times_[2]);
+                return NewRMW(p, dbsize_, rsetsize_, 0, wait_times_[2]);
         } else {
-            return new RMW(dbsize_, 0, wsetsize_, 0);
+            return NewRMW(p, dbsize_, 0, wsetsize_, 0);
         }
     }
 
@@ -148,10 +174,9 @@ void Benchmark(const vector<LoadGen*>& lg)
 {
     // Number of transaction requests that can be active at any given time.
     int active_txns = 100;
-    deque<Txn*> doneTxns;
 
     // For each MODE...
-    for (CCMode mode = SERIAL; mode <= MVCC_MV2PL; mode = static_cast<CCMode>(mode + 1))
+    for (CCMode mode = SERIAL; mode <= LOCKING_WOUND_WAIT; mode = static_cast<CCMode>(mode + 1))
     {
         // Print out mode name.
         cout << ModeToString(mode) << flush;
@@ -171,35 +196,29 @@ void Benchmark(const vector<LoadGen*>& lg)
                 double start = GetTime();
 
                 // Start specified number of txns running.
-                for (int i = 0; i < active_txns; i++) p->NewTxnRequest(lg[exp]->NewTxn());
+                for (int i = 0; i < active_txns; i++) p->NewTxnRequest(lg[exp]->NewTxn(p));
 
                 // Keep 100 active txns at all times for the first full second.
+                // Finished txns are recycled into the new ones.
                 while (GetTime() < start + 0.5)
                 {
-                    Txn* txn = p->GetTxnResult();
-                    doneTxns.push_back(txn);
+                    p->RecycleTxn(p->GetTxnResult());
                     txn_count++;
-                    p->NewTxnRequest(lg[exp]->NewTxn());
+                    p->NewTxnRequest(lg[exp]->NewTxn(p));
                 }
 
                 // Wait for all of them to finish.
                 for (int i = 0; i < active_txns; i++)
                 {
-                    Txn* txn = p->GetTxnResult();
-                    doneTxns.push_back(txn);
+                    p->RecycleTxn(p->GetTxnResult());
                     txn_count++;
                 }
                 // Record end time.
                 double end = GetTime();
 
                 throughput[round] = txn_count / (end - start);
-                 
-                for (auto it = doneTxns.begin(); it != doneTxns.end(); ++it)
-                {
-                    delete *it;
-                }
 
-                doneTxns.clear();
+                // Also deletes the recycled txns.
                 delete p;
             }
 
@@ -29,6 +29,7 @@ class Expect : public Txn
     Expect(const map<Key, Value>& m) : m_(m)
     {
         for (map<Key, Value>::iterator it = m_.begin(); it != m_.end(); ++it) readset_.insert(it->first);
+        DeclareReadOnly();
     }
 
     Expect* clone() const
@@ -86,16 +87,22 @@ class RMW : public Txn
 {
    public:
     explicit RMW(double time = 0) : time_(time) {}
-    RMW(const set<Key>& writeset, double time = 0) : time_(time) { writeset_ = writeset; }
+    RMW(const set<Key>& writeset, double time = 0) : time_(time) { writeset_.assign(writeset.begin(), writeset.end()); }
     RMW(const set<Key>& readset, const set<Key>& writeset, double time = 0) : time_(time)
     {
-        readset_  = readset;
-        writeset_ = writeset;
+        readset_.assign(readset.begin(), readset.end());
+        writeset_.assign(writeset.begin(), writeset.end());
     }
 
     // Constructor with randomized read/write sets
-    RMW(int dbsize, int readsetsize, int writesetsize, double time = 0) : time_(time)
+    RMW(int dbsize, int readsetsize, int writesetsize, double time = 0) { Init(dbsize, readsetsize, writesetsize, time); }
+
+    // Draws new randomized read/write sets. Requires: the txn is new or was
+    // reset (see TxnProcessor::ReuseTxn()).
+    void Init(int dbsize, int readsetsize, int writesetsize, double time = 0)
     {
+        time_ = time;
+
         // Make sure we can find enough unique keys.
         DCHECK(dbsize >= readsetsize + writesetsize);
 
@@ -120,6 +127,8 @@ class RMW : public Txn
             } while (readset_.count(key) || writeset_.count(key));
             writeset_.insert(key);
         }
+
+        if (writesetsize == 0) DeclareReadOnly();
     }
 
     RMW* clone() const
@@ -133,7 +142,7 @@ class RMW : public Txn
     {
         Value result;
         // Read everything in readset.
-        for (set<Key>::iterator it = readset_.begin(); it != readset_.end(); ++it) Read(*it, &result);
+        for (KeySet::iterator it = readset_.begin(); it != readset_.end(); ++it) Read(*it, &result);
 
         // Run while loop to simulate the txn logic(duration is time_).
         double begin = GetTime();
@@ -148,7 +157,7 @@ class RMW : public Txn
         }
 
         // Increment length of everything in writeset.
-        for (set<Key>::iterator it = writeset_.begin(); it != writeset_.end(); ++it)
+        for (KeySet::iterator it = writeset_.begin(); it != writeset_.end(); ++it)
         {
             result = 0;
             Read(*it, &result);
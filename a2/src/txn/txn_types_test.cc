@@ -1,5 +1,6 @@
 #include "txn.h"
 
+#include <sys/resource.h>
 #include <string>
 
 #include "txn_processor.h"
@@ -71,9 +72,302 @@ TEST(PutMultipleTest)
     END;
 }
 
+TEST(DenseStoragePutTest)
+{
+    TxnProcessor p(OCC_PARREL_BACKWARD_VALIDATION, DENSE_STORAGE);
+    Txn* t;
+
+    // One key inside the dense key range and one in the overflow area.
+    std::map<Key, Value> m = {{1, 2}, {2000000, 3}};
+    p.NewTxnRequest(new Put(m));
+    delete p.GetTxnResult();
+
+    p.NewTxnRequest(new Expect(m));
+    t = p.GetTxnResult();
+    EXPECT_EQ(COMMITTED, t->Status());
+    delete t;
+
+    END;
+}
+
+TEST(ReadOnlyTest)
+{
+    for (CCMode mode = SERIAL; mode <= LOCKING_WOUND_WAIT; mode = static_cast<CCMode>(mode + 1))
+    {
+        TxnProcessor p(mode);
+        Txn* t;
+
+        std::map<Key, Value> m1 = {{1, 2}, {5, 7}};
+        p.NewTxnRequest(new Put(m1));
+        delete p.GetTxnResult();
+
+        // Read-only txns see every txn that finished before they started.
+        t = new Expect(m1);
+        EXPECT_TRUE(t->ReadOnly());
+        p.NewTxnRequest(t);
+        t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+
+        std::map<Key, Value> m2 = {{1, 3}};
+        p.NewTxnRequest(new Expect(m2));
+        t = p.GetTxnResult();
+        EXPECT_EQ(ABORTED, t->Status());
+        delete t;
+
+        // ...and leave nothing behind that could hold up a later writer.
+        p.NewTxnRequest(new Put(m2));
+        t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+
+        p.NewTxnRequest(new Expect(m2));
+        t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+    }
+
+    END;
+}
+
+TEST(OverlappingSetsTest)
+{
+    // A key both read and written must not leave a txn waiting for itself.
+    for (CCMode mode = SERIAL; mode <= LOCKING_WOUND_WAIT; mode = static_cast<CCMode>(mode + 1))
+    {
+        TxnProcessor p(mode);
+        set<Key> readset = {1, 2}, writeset = {2, 3};
+        p.NewTxnRequest(new RMW(readset, writeset));
+        Txn* t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+
+        p.NewTxnRequest(new RMW(writeset));
+        t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+    }
+
+    END;
+}
+
+// Moves one unit from key 'from' to key 'to' (values wrap around, so the sum
+// of all keys stays 0).
+class Transfer : public Txn
+{
+   public:
+    Transfer(Key from, Key to) : from_(from), to_(to)
+    {
+        writeset_.insert(from);
+        writeset_.insert(to);
+    }
+
+    Transfer* clone() const
+    {
+        Transfer* clone = new Transfer(from_, to_);
+        this->CopyTxnInternals(clone);
+        return clone;
+    }
+
+    virtual void Run()
+    {
+        Value from = 0, to = 0;
+        Read(from_, &from);
+        Read(to_, &to);
+        Write(from_, from - 1);
+        Write(to_, to + 1);
+        COMMIT;
+    }
+
+   private:
+    Key from_, to_;
+};
+
+// Read-only: commits iff keys [0, num_keys) sum to 0.
+class ZeroSum : public Txn
+{
+   public:
+    explicit ZeroSum(Key num_keys) : num_keys_(num_keys)
+    {
+        for (Key key = 0; key < num_keys; key++) readset_.insert(key);
+        DeclareReadOnly();
+    }
+
+    ZeroSum* clone() const
+    {
+        ZeroSum* clone = new ZeroSum(num_keys_);
+        this->CopyTxnInternals(clone);
+        return clone;
+    }
+
+    virtual void Run()
+    {
+        Value sum = 0, value;
+        for (Key key = 0; key < num_keys_; key++)
+            if (Read(key, &value)) sum += value;
+        if (sum != 0) ABORT;
+        COMMIT;
+    }
+
+   private:
+    Key num_keys_;
+};
+
+TEST(ConcurrentSnapshotTest)
+{
+    // Read-only txns running alongside writers, while the collector trims
+    // versions, must still see a consistent snapshot.
+    const Key kKeys   = 8;
+    const int kTxns   = 20000;
+    const int kWindow = 1000;
+    for (CCMode mode = MVCC_MVTO; mode <= MVCC_SSI; mode = static_cast<CCMode>(mode + 1))
+    {
+        TxnProcessor p(mode);
+        srand(42);
+        int torn = 0, in_flight = 0;
+        for (int i = 0; i < kTxns; i++)
+        {
+            Key from = rand() % kKeys, to = (from + 1 + rand() % (kKeys - 1)) % kKeys;
+            p.NewTxnRequest(i % 4 == 0 ? static_cast<Txn*>(new ZeroSum(kKeys)) : new Transfer(from, to));
+            for (in_flight++; in_flight > (i + 1 < kTxns ? kWindow : 0); in_flight--)
+            {
+                Txn* t = p.GetTxnResult();
+                if (t->ReadOnly() && t->Status() != COMMITTED) torn++;
+                delete t;
+            }
+        }
+        EXPECT_EQ(torn, 0);
+
+        p.NewTxnRequest(new ZeroSum(kKeys));
+        Txn* t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+    }
+
+    END;
+}
+
+TEST(ConcurrentTransferTest)
+{
+    // Transfers read only the keys they write, so a lost update shows up as
+    // a nonzero sum.
+    const Key kKeys = 8;
+    const int kTxns = 2000;
+    for (CCMode mode = SERIAL; mode <= LOCKING_WOUND_WAIT; mode = static_cast<CCMode>(mode + 1))
+    {
+        TxnProcessor p(mode);
+        srand(42);
+        for (int i = 0; i < kTxns; i++)
+        {
+            Key from = rand() % kKeys, to = (from + 1 + rand() % (kKeys - 1)) % kKeys;
+            p.NewTxnRequest(new Transfer(from, to));
+        }
+        for (int i = 0; i < kTxns; i++) delete p.GetTxnResult();
+
+        p.NewTxnRequest(new ZeroSum(kKeys));
+        Txn* t = p.GetTxnResult();
+        EXPECT_EQ(COMMITTED, t->Status());
+        delete t;
+    }
+
+    END;
+}
+
+TEST(RecycleTest)
+{
+    TxnProcessor p(OCC_SILO);
+
+    RMW* t = new RMW(100, 0, 5);
+    p.NewTxnRequest(t);
+    EXPECT_TRUE(p.GetTxnResult() == t);
+    EXPECT_EQ(COMMITTED, t->Status());
+
+    // A recycled txn comes back reset, and runs again once re-initialized.
+    p.RecycleTxn(t);
+    RMW* reused = p.ReuseTxn<RMW>();
+    EXPECT_TRUE(reused == t);
+    EXPECT_EQ(INCOMPLETE, reused->Status());
+    EXPECT_TRUE(p.ReuseTxn<RMW>() == NULL);
+    reused->Init(100, 5, 0);
+    EXPECT_TRUE(reused->ReadOnly());
+    p.NewTxnRequest(reused);
+    EXPECT_EQ(COMMITTED, p.GetTxnResult()->Status());
+
+    // Recycled txns of another type are dropped.
+    p.RecycleTxn(new Noop());
+    EXPECT_TRUE(p.ReuseTxn<RMW>() == NULL);
+
+    // The processor deletes what is left over.
+    p.RecycleTxn(reused);
+
+    END;
+}
+
+TEST(OptionsTest)
+{
+    // Two workers pinned to CPU 0 and, where NUMA topology is available,
+    // everything bound to node 0, which every machine has.
+    TxnProcessorOptions options;
+    options.worker_count   = 2;
+    options.scheduler_core = 0;
+    options.worker_cores.push_back(0);
+    options.numa_node = NumaNodeCpus(0).empty() ? -1 : 0;
+
+    for (CCMode mode = LOCKING; mode <= OCC_SERIAL_BACKWARD_VALIDATION; mode = static_cast<CCMode>(mode + 1))
+    {
+        TxnProcessor p(mode, HASHED_STORAGE, options);
+        for (int i = 0; i < 10; i++) p.NewTxnRequest(new RMW(100, 2, 2));
+        for (int i = 0; i < 10; i++)
+        {
+            Txn* t = p.GetTxnResult();
+            EXPECT_EQ(COMMITTED, t->Status());
+            delete t;
+        }
+    }
+
+    END;
+}
+
+// Returns the CPU time used by the whole process so far, in seconds.
+static double ProcessCpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+TEST(IdleTest)
+{
+    TxnProcessor p(LOCKING);
+    p.NewTxnRequest(new RMW(100, 2, 2));
+    delete p.GetTxnResult();
+
+    // Once idle, the scheduler and workers park instead of polling.
+    usleep(50000);
+    double cpu = ProcessCpuTime();
+    usleep(200000);
+    EXPECT_TRUE(ProcessCpuTime() - cpu < 0.02);
+
+    // And wake up for the next request.
+    p.NewTxnRequest(new RMW(100, 2, 2));
+    Txn* t = p.GetTxnResult();
+    EXPECT_EQ(COMMITTED, t->Status());
+    delete t;
+
+    END;
+}
+
 int main(int argc, char** argv)
 {
     NoopTest();
     PutTest();
     PutMultipleTest();
+    DenseStoragePutTest();
+    ReadOnlyTest();
+    OverlappingSetsTest();
+    ConcurrentSnapshotTest();
+    ConcurrentTransferTest();
+    RecycleTest();
+    OptionsTest();
+    IdleTest();
 }
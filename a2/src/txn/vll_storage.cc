@@ -0,0 +1,32 @@
+#include "vll_storage.h"
+
+VllStorage::VllStorage(uint64 capacity) : records_(capacity, 1024, "VllStorage") {}
+
+VllStorage::~VllStorage() {}
+
+VllStorage::Record* VllStorage::RecordFor(Key key)
+{
+    return records_.FindOrClaim(key, [this](Record* record) { this->Seed(record); });
+}
+
+void VllStorage::Seed(Record* record)
+{
+    if (ReadImage(record->key_, &record->value_)) record->present_.store(1, std::memory_order_relaxed);
+}
+
+bool VllStorage::Read(Key key, Value* result, int txn_unique_id)
+{
+    // A key without a record was never written: it only has its image value.
+    Record* record = records_.Find(key);
+    if (record == NULL) return ReadImage(key, result);
+    if (!record->present_.load(std::memory_order_acquire)) return false;
+    *result = __atomic_load_n(&record->value_, __ATOMIC_RELAXED);
+    return true;
+}
+
+void VllStorage::Write(Key key, Value value, int txn_unique_id)
+{
+    Record* record = RecordFor(key);
+    __atomic_store_n(&record->value_, value, __ATOMIC_RELAXED);
+    record->present_.store(1, std::memory_order_release);
+}
@@ -0,0 +1,73 @@
+#ifndef _VLL_STORAGE_H_
+#define _VLL_STORAGE_H_
+
+#include <atomic>
+
+#include "slot_table.h"
+#include "storage.h"
+
+// Single-version storage for VLL (very lightweight locking). Every key owns
+// one cache-line sized record in a SlotTable (laid out like SiloStorage's)
+// holding its value and its lock state: two counters, CX and CS, of the txns
+// holding or waiting for an exclusive and a shared lock on it. A lock is
+// taken by bumping its counter and is free iff nothing else conflicts:
+// CX == 1 and CS == 0 for an exclusive lock, CX == 0 for a shared one. Who
+// waits for whom is left to the scheduler (see
+// TxnProcessor::RunVllScheduler()), so there are no request queues at all.
+class VllStorage : public Storage
+{
+   public:
+    struct alignas(CACHE_LINE_SIZE) Record
+    {
+        std::atomic<int32> cx_;
+        std::atomic<int32> cs_;
+        Value value_;
+        std::atomic<uint32> present_;  // 1 iff the record has a value
+        std::atomic<uint32> state_;    // See SlotTable
+        Key key_;
+    };
+
+    // Number of distinct keys the default-constructed storage holds before
+    // its table has to grow.
+    static const uint64 kDefaultCapacity = 1 << 21;
+
+    // 'capacity' is rounded up to a power of two. The table is reserved up
+    // front but mapped lazily, so only records that are used cost memory, and
+    // grows past 'capacity' as needed.
+    explicit VllStorage(uint64 capacity = kDefaultCapacity);
+    virtual ~VllStorage();
+
+    // Returns the record of 'key', creating it on first access (seeded from
+    // the attached image, unlocked).
+    Record* RecordFor(Key key);
+
+    // Requests an exclusive (shared) lock on 'record'. Returns true iff no
+    // other txn holds or waits for a conflicting lock on it.
+    static bool LockExclusive(Record* record)
+    {
+        return record->cx_.fetch_add(1) == 0 && record->cs_.load() == 0;
+    }
+    static bool LockShared(Record* record)
+    {
+        record->cs_.fetch_add(1);
+        return record->cx_.load() == 0;
+    }
+
+    // Drops an exclusive (shared) lock, or request, on 'record'.
+    static void UnlockExclusive(Record* record) { record->cx_.fetch_sub(1); }
+    static void UnlockShared(Record* record) { record->cs_.fetch_sub(1); }
+
+    // Access to the value. Callers hold a lock on the record, except for
+    // read-only txns, which detect concurrent commits themselves. Read()
+    // never creates a record.
+    virtual bool Read(Key key, Value* result, int txn_unique_id = 0);
+    virtual void Write(Key key, Value value, int txn_unique_id = 0);
+    virtual double Timestamp(Key key) { return 0; }
+
+   private:
+    void Seed(Record* record);
+
+    SlotTable<Record> records_;
+};
+
+#endif  // _VLL_STORAGE_H_
@@ -11,6 +11,7 @@
 using std::queue;
 using std::set;
 using std::unordered_map;
+using std::vector;
 
 /// @class AtomicMap<K, V>
 ///
@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <new>
 #include <string>
 #include <utility>
 
@@ -47,6 +48,43 @@ typedef uint64_t uint64;
 typedef uint64 Key;
 typedef uint64 Value;
 
+// Size of a cache line in bytes. Structures touched concurrently by different
+// threads are padded/aligned to this to avoid false sharing.
+#define CACHE_LINE_SIZE 64
+
+// Mixes the bits of 'key' (Fibonacci hashing). Pick shards/buckets from the
+// high bits of the product: its low bits only depend on the low bits of the
+// key, so keys with a common stride would share them.
+static inline uint64 HashKey(Key key) { return key * 0x9E3779B97F4A7C15ULL; }
+
+// Allocates an array of 'n' default-constructed T's starting on a cache line
+// boundary. (Plain new[] does not honour alignas() before C++17.)
+template <typename T>
+static inline T* NewCacheAlignedArray(int n)
+{
+    void* mem;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(T) * n) != 0) DIE("Failed to allocate " << n << " objects.");
+    T* array = static_cast<T*>(mem);
+    for (int i = 0; i < n; i++) new (&array[i]) T();
+    return array;
+}
+
+// Destroys and frees an array returned by NewCacheAlignedArray<T>(n).
+template <typename T>
+static inline void DeleteCacheAlignedArray(T* array, int n)
+{
+    for (int i = 0; i < n; i++) array[i].~T();
+    free(array);
+}
+
+// Hint to the CPU that the caller is busy-waiting.
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
 // Returns the number of seconds since midnight according to local system time,
 // to the nearest microsecond.
 static inline double GetTime()
@@ -0,0 +1,112 @@
+#ifndef _DB_UTILS_CPU_AFFINITY_H_
+#define _DB_UTILS_CPU_AFFINITY_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#include "utils/common.h"
+
+using std::vector;
+
+/// @struct CpuPlacement
+///
+/// Where a group of threads (e.g. the workers of a pool) runs. Thread i of
+/// the group is pinned to cores[i % cores.size()]; with no cores given,
+/// threads run anywhere on 'numa_node' (or anywhere at all if it is -1).
+/// With a node given, memory the threads allocate comes from that node
+/// whenever it has any free.
+struct CpuPlacement
+{
+    CpuPlacement() : numa_node(-1) {}
+
+    vector<int> cores;
+    int numa_node;
+};
+
+// Returns the CPUs of NUMA node 'node' (empty if there is no such node, or
+// NUMA topology is not available).
+static inline vector<int> NumaNodeCpus(int node)
+{
+    vector<int> cpus;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return cpus;
+
+    // A list of ranges, e.g. "0-15,32-47".
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1) break;
+            c = fgetc(file);
+        }
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        if (c != ',') break;
+    }
+    fclose(file);
+    return cpus;
+}
+
+// Makes the calling thread prefer NUMA node 'node' for the memory it
+// allocates from now on (-1: back to the system default, local allocation).
+// Where memory policies are unavailable (kernels without NUMA support,
+// sandboxes that filter the call), warns once and leaves allocation as is.
+static inline void SetNumaAllocationNode(int node)
+{
+#if defined(__linux__)
+    if (node < 0)
+    {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    unsigned long mask[16] = {0};
+    if (node >= (int)(8 * sizeof(mask))) DIE("NUMA node " << node << " out of range.");
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 8 * sizeof(mask)) != 0)
+    {
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true))
+            fprintf(stderr, "Warning: failed to prefer NUMA node %d for allocations (%s); not binding memory.\n",
+                    node, strerror(errno));
+    }
+#endif
+}
+
+// Moves the calling thread, as thread 'index' of a group, to where
+// 'placement' puts it.
+static inline void PlaceCurrentThread(const CpuPlacement& placement, int index)
+{
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+    vector<int> cpus;
+    if (!placement.cores.empty())
+        cpus.push_back(placement.cores[index % placement.cores.size()]);
+    else if (placement.numa_node >= 0)
+        cpus = NumaNodeCpus(placement.numa_node);
+
+    if (!cpus.empty())
+    {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (size_t i = 0; i < cpus.size(); i++) CPU_SET(cpus[i], &cpuset);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+            DIE("Failed to pin thread " << index << " to its CPUs.");
+    }
+#endif
+    if (placement.numa_node >= 0) SetNumaAllocationNode(placement.numa_node);
+}
+
+#endif  // _DB_UTILS_CPU_AFFINITY_H_
@@ -0,0 +1,133 @@
+#ifndef _DB_UTILS_EPOCH_MANAGER_H_
+#define _DB_UTILS_EPOCH_MANAGER_H_
+
+#include <atomic>
+
+#include "utils/common.h"
+
+/// @class EpochManager
+///
+/// Tracks a low-watermark of the timestamps of active transactions, for MVCC
+/// garbage collection. Instead of keeping every active timestamp in a shared
+/// set, transactions are counted per coarse epoch: entering and leaving are
+/// each a single atomic add on the (cache-line-private) slot of the epoch
+/// they entered in, and only LowWatermark() looks at all slots.
+///
+/// Enter() must be called by a single thread at a time, with non-decreasing
+/// timestamps (in TxnProcessor: the scheduler, which dispatches in unique_id_
+/// order). Exit() and the watermark queries may be called from any thread.
+class EpochManager
+{
+   public:
+    // No transaction may ever Enter() with a timestamp below 'first_ts'.
+    explicit EpochManager(int first_ts = 0) : epoch_(0), next_ts_(first_ts), low_watermark_(first_ts)
+    {
+        slots_ = NewCacheAlignedArray<Slot>(kEpochs);
+    }
+    ~EpochManager() { DeleteCacheAlignedArray(slots_, kEpochs); }
+
+    // Registers a transaction with timestamp 'ts' as active. Returns the epoch
+    // token to hand to Exit().
+    uint64 Enter(int ts)
+    {
+        uint64 epoch;
+        while (true)
+        {
+            epoch      = epoch_.load();
+            Slot& slot = slots_[epoch % kEpochs];
+            // First transaction of this epoch, or the first since the slot
+            // drained: record the smallest timestamp of the slot before
+            // counting it, so that a reader that sees the count sees this
+            // timestamp (not that of an earlier transaction, which would
+            // keep the watermark needlessly low). Nothing is counted in the
+            // slot yet, and only this thread adds to the count.
+            if (slot.epoch_.load(std::memory_order_relaxed) != epoch || slot.active_.load() == 0)
+            {
+                slot.first_ts_.store(ts);
+                slot.epoch_.store(epoch);
+            }
+            slot.active_.fetch_add(1);
+            // If the epoch advanced in between, the slot may already belong to
+            // a different epoch. Undo and retry in the new one.
+            if (epoch_.load() == epoch) break;
+            slot.active_.fetch_sub(1);
+        }
+        next_ts_.store(ts + 1);
+        return epoch;
+    }
+
+    // Unregisters a transaction that entered in 'epoch'.
+    void Exit(uint64 epoch) { slots_[epoch % kEpochs].active_.fetch_sub(1); }
+
+    // Returns a timestamp W such that every currently active transaction, and
+    // every transaction that will Enter() later, has timestamp >= W. Never
+    // decreases. Safe to call from any thread.
+    int LowWatermark() const
+    {
+        // Anything that enters after this load has a timestamp >= it. A slot
+        // may hold a first_ts_ below its active transactions' (if it drained
+        // and refilled while the scan looked at it), so a fresh bound may be
+        // lower than an earlier one; both are safe, so keep the larger.
+        int watermark = OldestActive(next_ts_.load());
+        int previous  = low_watermark_.load();
+        while (previous < watermark && !low_watermark_.compare_exchange_weak(previous, watermark))
+        {
+        }
+        return previous < watermark ? watermark : previous;
+    }
+
+    // Returns the smallest timestamp of any active transaction, or 'bound' if
+    // that is smaller (or nothing is active). Safe to call from any thread.
+    int OldestActive(int bound) const
+    {
+        int oldest = bound;
+        for (int i = 0; i < kEpochs; i++)
+        {
+            if (slots_[i].active_.load() > 0)
+            {
+                int first_ts = slots_[i].first_ts_.load();
+                if (first_ts < oldest) oldest = first_ts;
+            }
+        }
+        return oldest;
+    }
+
+    // Moves new transactions to the next epoch once the slot it would reuse
+    // has drained. Must be called periodically, by a single thread (the
+    // garbage collector), or the watermark stops advancing past long-running
+    // transactions' epochs.
+    void Advance()
+    {
+        uint64 epoch = epoch_.load();
+        if (slots_[(epoch + 1) % kEpochs].active_.load() == 0) epoch_.store(epoch + 1);
+    }
+
+   private:
+    // Number of epoch slots. An epoch's slot is only reused once every
+    // transaction that entered kEpochs epochs ago has exited (see Advance()).
+    static const int kEpochs = 64;
+
+    // Epoch of a slot no transaction has entered yet (never a real epoch).
+    static const uint64 kNoEpoch = ~0ULL;
+
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        Slot() : active_(0), first_ts_(0), epoch_(kNoEpoch) {}
+        std::atomic<int64> active_;    // Transactions counted in this slot
+        std::atomic<int> first_ts_;    // Smallest timestamp entered in 'epoch_'
+        std::atomic<uint64> epoch_;    // Epoch the slot currently belongs to
+    };
+
+    Slot* slots_;
+
+    // Epoch new transactions enter in.
+    std::atomic<uint64> epoch_;
+
+    // One past the largest timestamp passed to Enter().
+    std::atomic<int> next_ts_;
+
+    // Largest value LowWatermark() has returned.
+    mutable std::atomic<int> low_watermark_;
+};
+
+#endif  // _DB_UTILS_EPOCH_MANAGER_H_
@@ -0,0 +1,89 @@
+#ifndef _DB_UTILS_EVENT_COUNT_H_
+#define _DB_UTILS_EVENT_COUNT_H_
+
+#include <limits.h>
+#include <sched.h>
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "utils/common.h"
+
+/// @class EventCount
+///
+/// Lets threads sleep until some condition on lock-free state (e.g. "a queue
+/// is non-empty") may have become true, without putting a lock on the state's
+/// fast path. A waiter announces itself, re-checks the condition, and only
+/// then sleeps; a notifier, after making the condition true, wakes sleepers
+/// only if some thread announced itself, so notifying costs a fence and a
+/// load while nobody waits.
+///
+///   uint32 ticket = ec.PrepareWait();
+///   if (condition) ec.CancelWait(); else ec.Wait(ticket);
+///
+/// A Notify*() that follows a PrepareWait() always wakes that waiter (or keeps
+/// it from sleeping), so no wake-up is lost. Sleeping is a futex wait on
+/// Linux, and yielding the CPU elsewhere.
+class EventCount
+{
+   public:
+    EventCount() : epoch_(0), waiters_(0) {}
+
+    // Announces the caller as a waiter. It must re-check its condition and
+    // then call exactly one of Wait() and CancelWait() with the result.
+    uint32 PrepareWait()
+    {
+        waiters_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_acquire);
+    }
+
+    // Withdraws the announcement (the condition held after all).
+    void CancelWait() { waiters_.fetch_sub(1); }
+
+    // Sleeps until some Notify*() following the PrepareWait() that returned
+    // 'ticket'. May also return spuriously.
+    void Wait(uint32 ticket)
+    {
+        while (epoch_.load(std::memory_order_acquire) == ticket) Park(ticket);
+        waiters_.fetch_sub(1);
+    }
+
+    // Wakes one waiter. Call after making the condition true.
+    void NotifyOne() { Notify(1); }
+
+    // Wakes all waiters. Call after making the condition true.
+    void NotifyAll() { Notify(INT_MAX); }
+
+   private:
+    void Notify(int count)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) return;
+        epoch_.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32*>(&epoch_), FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#endif
+    }
+
+    void Park(uint32 ticket)
+    {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32*>(&epoch_), FUTEX_WAIT_PRIVATE, ticket, NULL, NULL, 0);
+#else
+        sched_yield();
+#endif
+    }
+
+    // Bumped by every Notify*() that found a waiter; sleepers wait for it to
+    // change.
+    std::atomic<uint32> epoch_;
+
+    // Number of threads between PrepareWait() and Wait()/CancelWait().
+    std::atomic<uint32> waiters_;
+};
+
+#endif  // _DB_UTILS_EVENT_COUNT_H_
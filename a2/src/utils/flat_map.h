@@ -0,0 +1,191 @@
+#ifndef _DB_UTILS_FLAT_MAP_H_
+#define _DB_UTILS_FLAT_MAP_H_
+
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+
+#include "utils/common.h"
+
+/// @class SmallVector<T, N>
+///
+/// Contiguous array of trivially copyable T's whose first N elements live
+/// inside the object itself: it only allocates once it grows past N. clear()
+/// keeps the capacity, so a cleared vector refills without allocating.
+template <typename T, int N>
+class SmallVector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable types");
+
+   public:
+    SmallVector() : data_(Inline()), size_(0), capacity_(N) {}
+    SmallVector(const SmallVector& other) : data_(Inline()), size_(0), capacity_(N) { *this = other; }
+    ~SmallVector()
+    {
+        if (data_ != Inline()) free(data_);
+    }
+
+    SmallVector& operator=(const SmallVector& other)
+    {
+        if (this != &other)
+        {
+            Reserve(other.size_);
+            memcpy(data_, other.data_, other.size_ * sizeof(T));
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    uint32 size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; }
+
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+    T& operator[](uint32 i) { return data_[i]; }
+    const T& operator[](uint32 i) const { return data_[i]; }
+
+    // Inserts 'value' before 'pos' and returns where it ended up.
+    T* Insert(const T* pos, const T& value)
+    {
+        uint32 i = pos - data_;
+        if (size_ == capacity_) Reserve(2 * capacity_);
+        memmove(data_ + i + 1, data_ + i, (size_ - i) * sizeof(T));
+        data_[i] = value;
+        size_++;
+        return data_ + i;
+    }
+
+    // Makes room for 'capacity' elements.
+    void Reserve(uint32 capacity)
+    {
+        if (capacity <= capacity_) return;
+        T* data = static_cast<T*>(malloc(capacity * sizeof(T)));
+        if (data == NULL) DIE("Failed to allocate " << capacity << " elements.");
+        memcpy(data, data_, size_ * sizeof(T));
+        if (data_ != Inline()) free(data_);
+        data_     = data;
+        capacity_ = capacity;
+    }
+
+   private:
+    T* Inline() { return reinterpret_cast<T*>(inline_); }
+
+    T* data_;
+    uint32 size_;
+    uint32 capacity_;
+    alignas(T) unsigned char inline_[N * sizeof(T)];
+};
+
+/// @class FlatSet<K, N>
+///
+/// Ordered set kept as a sorted SmallVector<K, N>: iteration is a walk over
+/// a contiguous array and data() can be handed to array kernels directly.
+/// Supports the subset of the std::set interface transactions use.
+template <typename K, int N>
+class FlatSet
+{
+   public:
+    typedef const K* iterator;
+    typedef const K* const_iterator;
+
+    iterator begin() const { return keys_.begin(); }
+    iterator end() const { return keys_.end(); }
+    const K* data() const { return keys_.data(); }
+    uint32 size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+    void clear() { keys_.clear(); }
+
+    iterator find(const K& key) const
+    {
+        iterator it = std::lower_bound(begin(), end(), key);
+        return (it != end() && *it == key) ? it : end();
+    }
+
+    uint32 count(const K& key) const { return find(key) != end(); }
+
+    void insert(const K& key)
+    {
+        iterator it = std::lower_bound(begin(), end(), key);
+        if (it == end() || *it != key) keys_.Insert(it, key);
+    }
+
+    // Replaces the contents with the keys in [first, last) (appending is
+    // cheapest when they come in order, e.g. from a std::set).
+    template <typename It>
+    void assign(It first, It last)
+    {
+        clear();
+        for (; first != last; ++first) insert(*first);
+    }
+
+   private:
+    SmallVector<K, N> keys_;
+};
+
+// Element of a FlatMap, laid out like std::pair.
+template <typename K, typename V>
+struct FlatPair
+{
+    K first;
+    V second;
+};
+
+/// @class FlatMap<K, V, N>
+///
+/// Ordered map kept as a SmallVector<FlatPair<K, V>, N> sorted by key: keys
+/// and values sit next to each other in one contiguous array. Supports the
+/// subset of the std::map interface transactions use.
+template <typename K, typename V, int N>
+class FlatMap
+{
+   public:
+    typedef FlatPair<K, V> value_type;
+    typedef value_type* iterator;
+    typedef const value_type* const_iterator;
+
+    iterator begin() { return pairs_.begin(); }
+    iterator end() { return pairs_.end(); }
+    const_iterator begin() const { return pairs_.begin(); }
+    const_iterator end() const { return pairs_.end(); }
+    uint32 size() const { return pairs_.size(); }
+    bool empty() const { return pairs_.empty(); }
+    void clear() { pairs_.clear(); }
+
+    iterator find(const K& key)
+    {
+        iterator it = LowerBound(key);
+        return (it != end() && it->first == key) ? it : end();
+    }
+    const_iterator find(const K& key) const { return const_cast<FlatMap*>(this)->find(key); }
+
+    uint32 count(const K& key) const { return find(key) != end(); }
+
+    // Returns the value of 'key', inserting a value-initialized one first if
+    // there is none.
+    V& operator[](const K& key)
+    {
+        iterator it = LowerBound(key);
+        if (it == end() || it->first != key)
+        {
+            value_type pair = {key, V()};
+            it              = pairs_.Insert(it, pair);
+        }
+        return it->second;
+    }
+
+   private:
+    iterator LowerBound(const K& key)
+    {
+        return std::lower_bound(begin(), end(), key, [](const value_type& pair, const K& k) { return pair.first < k; });
+    }
+
+    SmallVector<value_type, N> pairs_;
+};
+
+#endif  // _DB_UTILS_FLAT_MAP_H_
@@ -0,0 +1,344 @@
+#ifndef _DB_UTILS_LOCK_FREE_QUEUE_H_
+#define _DB_UTILS_LOCK_FREE_QUEUE_H_
+
+#include <sched.h>
+#include <atomic>
+#include <utility>
+
+#include "utils/atomic.h"
+#include "utils/common.h"
+
+// Spins on a full queue before a blocking Push() yields the CPU.
+#define LOCK_FREE_QUEUE_SPINS_BEFORE_YIELD 64
+
+static inline void LockFreeQueueBackoff(int* spins)
+{
+    if (++*spins > LOCK_FREE_QUEUE_SPINS_BEFORE_YIELD) sched_yield();
+}
+
+/// @class MPMCQueue<T>
+///
+/// Bounded lock-free queue for any number of producers and consumers: a ring
+/// of slots, each carrying a sequence number that tells a producer whether
+/// the slot is free for its turn and a consumer whether it holds the element
+/// of its turn (Vyukov's bounded MPMC queue). Producers and consumers claim
+/// turns by CAS on tail_ and head_, so the only operation that ever waits for
+/// another thread is a Push() on a full queue.
+///
+/// Same interface as AtomicQueue<T>, plus batch operations. Nothing here
+/// takes a latch, so the NonBlocking variants only differ in that
+/// PushNonBlocking() fails, rather than waits, when the queue is full.
+template <typename T>
+class MPMCQueue
+{
+   public:
+    static const uint64 kDefaultCapacity = 1 << 12;
+
+    // 'capacity' is rounded up to a power of two.
+    explicit MPMCQueue(uint64 capacity = kDefaultCapacity) : head_(0), tail_(0)
+    {
+        capacity_ = 1;
+        while (capacity_ < capacity) capacity_ <<= 1;
+        mask_  = capacity_ - 1;
+        cells_ = new Cell[capacity_];
+        for (uint64 i = 0; i < capacity_; i++) cells_[i].seq_.store(i, std::memory_order_relaxed);
+    }
+
+    ~MPMCQueue() { delete[] cells_; }
+
+    // Returns the number of elements currently in the queue.
+    int Size() { return tail_.load() - head_.load(); }
+
+    // Pushes 'item' onto the queue, waiting for room if it is full.
+    void Push(const T& item)
+    {
+        for (int spins = 0; !Enqueue(item);) LockFreeQueueBackoff(&spins);
+    }
+
+    void Push(T&& item)
+    {
+        for (int spins = 0; !Enqueue(std::move(item));) LockFreeQueueBackoff(&spins);
+    }
+
+    // If the queue is non-empty, sets '*result' equal to the front element,
+    // pops it, and returns true, otherwise returns false.
+    bool Pop(T* result)
+    {
+        uint64 pos = head_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell* cell = &cells_[pos & mask_];
+            int64 diff = cell->seq_.load(std::memory_order_acquire) - (pos + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    *result = std::move(cell->item_);
+                    cell->seq_.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // If the queue is not full, pushes and returns true, else immediately
+    // returns false.
+    bool PushNonBlocking(const T& item) { return Enqueue(item); }
+    bool PushNonBlocking(T&& item) { return Enqueue(std::move(item)); }
+
+    // Synonym for 'Pop(result)'.
+    bool PopNonBlocking(T* result) { return Pop(result); }
+
+    // Pushes a prefix of the 'n' elements of 'items', in order, under a single
+    // claim of the tail, and returns its length: less than 'n' only if the
+    // queue (nearly) filled up.
+    int PushBatch(const T* items, int n)
+    {
+        uint64 pos = tail_.load(std::memory_order_relaxed);
+        while (n > 0)
+        {
+            int k = 0;
+            while (k < n && cells_[(pos + k) & mask_].seq_.load(std::memory_order_acquire) == pos + k) k++;
+            if (k == 0)
+            {
+                int64 diff = cells_[pos & mask_].seq_.load(std::memory_order_acquire) - pos;
+                if (diff < 0) return 0;
+                pos = tail_.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (tail_.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+            {
+                for (int i = 0; i < k; i++)
+                {
+                    Cell* cell  = &cells_[(pos + i) & mask_];
+                    cell->item_ = items[i];
+                    cell->seq_.store(pos + i + 1, std::memory_order_release);
+                }
+                return k;
+            }
+        }
+        return 0;
+    }
+
+    // Pops up to 'n' elements into 'items', in order, under a single claim of
+    // the head, and returns how many it popped (0 if the queue is empty).
+    int PopBatch(T* items, int n)
+    {
+        uint64 pos = head_.load(std::memory_order_relaxed);
+        while (n > 0)
+        {
+            int k = 0;
+            while (k < n && cells_[(pos + k) & mask_].seq_.load(std::memory_order_acquire) == pos + k + 1) k++;
+            if (k == 0)
+            {
+                int64 diff = cells_[pos & mask_].seq_.load(std::memory_order_acquire) - (pos + 1);
+                if (diff < 0) return 0;
+                pos = head_.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (head_.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+            {
+                for (int i = 0; i < k; i++)
+                {
+                    Cell* cell = &cells_[(pos + i) & mask_];
+                    items[i]   = std::move(cell->item_);
+                    cell->seq_.store(pos + i + capacity_, std::memory_order_release);
+                }
+                return k;
+            }
+        }
+        return 0;
+    }
+
+   private:
+    struct Cell
+    {
+        // Turn of the producer that may fill the slot next (== the turn's
+        // position) or, once filled, that position + 1.
+        std::atomic<uint64> seq_;
+        T item_;
+    };
+
+    template <typename U>
+    bool Enqueue(U&& item)
+    {
+        uint64 pos = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell* cell = &cells_[pos & mask_];
+            int64 diff = cell->seq_.load(std::memory_order_acquire) - pos;
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell->item_ = std::forward<U>(item);
+                    cell->seq_.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Cell* cells_;
+    uint64 capacity_;
+    uint64 mask_;  // capacity_ - 1
+
+    // Producers and consumers each get their own cache line.
+    char pad0_[CACHE_LINE_SIZE];
+    std::atomic<uint64> head_;
+    char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<uint64>)];
+    std::atomic<uint64> tail_;
+    char pad2_[CACHE_LINE_SIZE - sizeof(std::atomic<uint64>)];
+};
+
+/// @class SpillQueue<T>
+///
+/// Unbounded queue for any number of producers and consumers: an MPMCQueue
+/// that, rather than making a producer wait while it is full, spills pushes
+/// to a latched AtomicQueue, which consumers drain after the ring. Push()
+/// never waits for a consumer, so a consumer may push into the queue it
+/// drains. While anything is spilled, pushes go to the spill list too, so
+/// the elements one thread pushes still come out in order.
+template <typename T>
+class SpillQueue
+{
+   public:
+    // The ring holds 'capacity' elements (rounded up to a power of two).
+    explicit SpillQueue(int capacity) : ring_(capacity), spilled_(0) {}
+
+    // Returns the number of elements currently in the queue.
+    int Size() { return ring_.Size() + spilled_.load(); }
+
+    // Pushes 'item' onto the queue.
+    void Push(const T& item)
+    {
+        if (spilled_.load() == 0 && ring_.PushNonBlocking(item)) return;
+        spilled_.fetch_add(1);
+        spill_.Push(item);
+    }
+
+    // If the queue is non-empty, sets '*result' equal to the front element,
+    // pops it, and returns true, otherwise returns false.
+    bool Pop(T* result)
+    {
+        if (ring_.Pop(result)) return true;
+        if (spilled_.load() == 0 || !spill_.Pop(result)) return false;
+        spilled_.fetch_sub(1);
+        return true;
+    }
+
+   private:
+    MPMCQueue<T> ring_;
+    AtomicQueue<T> spill_;
+
+    // Elements pushed to 'spill_' and not popped yet.
+    std::atomic<int> spilled_;
+};
+
+/// @class SPSCQueue<T>
+///
+/// Bounded lock-free queue for exactly one producer thread and one consumer
+/// thread: a ring indexed by a head only the consumer writes and a tail only
+/// the producer writes. Each side also caches the other side's index, so it
+/// only touches the other side's cache line when the ring looks full (or
+/// empty) by its cached copy.
+///
+/// Same interface as MPMCQueue<T>; Size() may be called from any thread.
+template <typename T>
+class SPSCQueue
+{
+   public:
+    static const uint64 kDefaultCapacity = 1 << 12;
+
+    // 'capacity' is rounded up to a power of two.
+    explicit SPSCQueue(uint64 capacity = kDefaultCapacity) : head_(0), cached_tail_(0), tail_(0), cached_head_(0)
+    {
+        capacity_ = 1;
+        while (capacity_ < capacity) capacity_ <<= 1;
+        mask_  = capacity_ - 1;
+        items_ = new T[capacity_];
+    }
+
+    ~SPSCQueue() { delete[] items_; }
+
+    // Returns the number of elements currently in the queue.
+    int Size() { return tail_.load() - head_.load(); }
+
+    // Pushes 'item' onto the queue, waiting for room if it is full. Producer
+    // only.
+    void Push(const T& item)
+    {
+        for (int spins = 0; PushBatch(&item, 1) == 0;) LockFreeQueueBackoff(&spins);
+    }
+
+    // If the queue is non-empty, sets '*result' equal to the front element,
+    // pops it, and returns true, otherwise returns false. Consumer only.
+    bool Pop(T* result) { return PopBatch(result, 1) == 1; }
+
+    // If the queue is not full, pushes and returns true, else immediately
+    // returns false. Producer only.
+    bool PushNonBlocking(const T& item) { return PushBatch(&item, 1) == 1; }
+
+    // Synonym for 'Pop(result)'.
+    bool PopNonBlocking(T* result) { return Pop(result); }
+
+    // Pushes as many of the 'n' elements of 'items' as fit, in order, and
+    // returns how many it pushed. Producer only.
+    int PushBatch(const T* items, int n)
+    {
+        uint64 tail = tail_.load(std::memory_order_relaxed);
+        if (tail + n - cached_head_ > capacity_) cached_head_ = head_.load(std::memory_order_acquire);
+        uint64 room = capacity_ - (tail - cached_head_);
+        if ((uint64)n > room) n = room;
+        for (int i = 0; i < n; i++) items_[(tail + i) & mask_] = items[i];
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Pops up to 'n' elements into 'items', in order, and returns how many it
+    // popped. Consumer only.
+    int PopBatch(T* items, int n)
+    {
+        uint64 head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < (uint64)n) cached_tail_ = tail_.load(std::memory_order_acquire);
+        uint64 available = cached_tail_ - head;
+        if ((uint64)n > available) n = available;
+        for (int i = 0; i < n; i++) items[i] = std::move(items_[(head + i) & mask_]);
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+   private:
+    T* items_;
+    uint64 capacity_;
+    uint64 mask_;  // capacity_ - 1
+
+    // Consumer side.
+    char pad0_[CACHE_LINE_SIZE];
+    std::atomic<uint64> head_;
+    uint64 cached_tail_;
+    char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<uint64>) - sizeof(uint64)];
+
+    // Producer side.
+    std::atomic<uint64> tail_;
+    uint64 cached_head_;
+    char pad2_[CACHE_LINE_SIZE - sizeof(std::atomic<uint64>) - sizeof(uint64)];
+};
+
+#endif  // _DB_UTILS_LOCK_FREE_QUEUE_H_
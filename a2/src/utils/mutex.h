@@ -2,6 +2,10 @@
 #define _DB_UTILS_MUTEX_H_
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include <atomic>
 
 /// @class Mutex
 ///
@@ -56,4 +60,41 @@ class MutexRW
     pthread_rwlock_t rwlock_;
 };
 
+/// @class SpinLock
+///
+/// A one-word test-and-test-and-set lock, small enough to embed in every
+/// record. Meant for critical sections of a few instructions: a waiter spins
+/// briefly, then yields the CPU so it never burns a time slice the holder
+/// could be using. A zero-filled SpinLock is unlocked.
+class SpinLock
+{
+   public:
+    SpinLock() : locked_(0) {}
+    /// Locks the spin lock. Blocks until it has been successfully acquired.
+    inline void Lock()
+    {
+        int spins = 0;
+        while (locked_.exchange(1, std::memory_order_acquire))
+        {
+            while (locked_.load(std::memory_order_relaxed))
+                if (++spins > kSpinsBeforeYield) sched_yield();
+        }
+    }
+    /// Attempts to lock the spin lock. If it is not already locked, locks it
+    /// and returns true, else returns false.
+    inline bool TryLock()
+    {
+        return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(1, std::memory_order_acquire);
+    }
+    /// Releases an already held spin lock.
+    ///
+    /// Requires: The lock is held.
+    inline void Unlock() { locked_.store(0, std::memory_order_release); }
+
+   private:
+    static const int kSpinsBeforeYield = 64;
+
+    std::atomic<uint32_t> locked_;
+};
+
 #endif  // _DB_UTILS_MUTEX_H_
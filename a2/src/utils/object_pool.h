@@ -0,0 +1,127 @@
+#ifndef _DB_UTILS_OBJECT_POOL_H_
+#define _DB_UTILS_OBJECT_POOL_H_
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "utils/common.h"
+#include "utils/mutex.h"
+
+/// @class ObjectPool
+///
+/// A slab allocator for fixed-size objects of type T, shared by many threads.
+/// Objects are carved out of large slabs and recycled through free lists, so
+/// New()/Delete() cost a few instructions instead of a trip through malloc.
+///
+/// Free lists are striped: each thread allocates from and frees into its own
+/// stripe. A thread whose stripe runs dry first takes the free list of some
+/// other stripe (so objects freed by one thread, e.g. a garbage collector, are
+/// reused by the threads that allocate), and only then carves a new slab.
+///
+/// Slabs are only returned to the system when the pool is destroyed; any
+/// object still live at that point is released without its destructor.
+template <typename T>
+class ObjectPool
+{
+   public:
+    ObjectPool() { stripes_ = NewCacheAlignedArray<Stripe>(kStripes); }
+
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < slabs_.size(); i++) free(slabs_[i]);
+        DeleteCacheAlignedArray(stripes_, kStripes);
+    }
+
+    // Returns a new default-constructed T.
+    T* New()
+    {
+        Stripe& stripe = stripes_[ThreadStripe()];
+        stripe.latch_.Lock();
+        if (stripe.free_ == NULL) Refill(&stripe);
+        Node* node   = stripe.free_;
+        stripe.free_ = node->next_;
+        stripe.latch_.Unlock();
+        return new (&node->object_) T();
+    }
+
+    // Destroys '*object' and returns its memory to the pool.
+    //
+    // Requires: 'object' was returned by New() on this pool.
+    void Delete(T* object)
+    {
+        object->~T();
+        Node* node     = reinterpret_cast<Node*>(object);
+        Stripe& stripe = stripes_[ThreadStripe()];
+        stripe.latch_.Lock();
+        node->next_  = stripe.free_;
+        stripe.free_ = node;
+        stripe.latch_.Unlock();
+    }
+
+   private:
+    // Disallow copying.
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    // Number of free-list stripes, and objects carved per slab.
+    static const int kStripes     = 16;
+    static const int kSlabObjects = 1024;
+
+    // A free object overlays its free-list link on the object storage.
+    union Node
+    {
+        Node* next_;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type object_;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Stripe
+    {
+        Stripe() : free_(NULL) {}
+        SpinLock latch_;
+        Node* free_;
+    };
+
+    // Returns the stripe of the calling thread. Threads are assigned stripes
+    // round-robin on first use.
+    static int ThreadStripe()
+    {
+        static std::atomic<int> next_stripe(0);
+        static thread_local int stripe = next_stripe.fetch_add(1) % kStripes;
+        return stripe;
+    }
+
+    // Refills the (locked, empty) '*stripe'.
+    void Refill(Stripe* stripe)
+    {
+        // Take over another stripe's whole free list. Stripes are only
+        // try-locked, so two refilling threads can never deadlock.
+        for (int i = 0; i < kStripes; i++)
+        {
+            Stripe* other = &stripes_[i];
+            if (other == stripe || !other->latch_.TryLock()) continue;
+            stripe->free_ = other->free_;
+            other->free_  = NULL;
+            other->latch_.Unlock();
+            if (stripe->free_ != NULL) return;
+        }
+
+        Node* slab = static_cast<Node*>(malloc(kSlabObjects * sizeof(Node)));
+        if (slab == NULL) DIE("Failed to allocate an object pool slab.");
+        slabs_latch_.Lock();
+        slabs_.push_back(slab);
+        slabs_latch_.Unlock();
+        for (int i = 0; i < kSlabObjects - 1; i++) slab[i].next_ = &slab[i + 1];
+        slab[kSlabObjects - 1].next_ = NULL;
+        stripe->free_                = slab;
+    }
+
+    Stripe* stripes_;
+
+    // Every slab allocated so far.
+    Mutex slabs_latch_;
+    std::vector<Node*> slabs_;
+};
+
+#endif  // _DB_UTILS_OBJECT_POOL_H_
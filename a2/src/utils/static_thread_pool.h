@@ -1,6 +1,7 @@
 #ifndef _DB_UTILS_STATIC_THREAD_POOL_H_
 #define _DB_UTILS_STATIC_THREAD_POOL_H_
 
+#include <atomic>
 #include <queue>
 #include <string>
 #include <utility>
@@ -8,7 +9,8 @@
 #include "assert.h"
 #include "pthread.h"
 #include "stdlib.h"
-#include "utils/atomic.h"
+#include "utils/cpu_affinity.h"
+#include "utils/lock_free_queue.h"
 #include "utils/thread_pool.h"
 
 using std::queue;
@@ -20,55 +22,46 @@ using std::pair;
 class StaticThreadPool : public ThreadPool
 {
    public:
-    StaticThreadPool(int nthreads) : thread_count_(nthreads), stopped_(false) { Start(); }
+    StaticThreadPool(int nthreads, const CpuPlacement& placement = CpuPlacement())
+        : thread_count_(nthreads), placement_(placement), next_queue_(0), stopped_(false)
+    {
+        Start();
+    }
     ~StaticThreadPool()
     {
         stopped_ = true;
         for (int i = 0; i < thread_count_; i++) pthread_join(threads_[i], NULL);
+        DeleteCacheAlignedArray(queues_, thread_count_);
     }
 
     bool Active() { return !stopped_; }
+    // Queues 'task' on the next worker in round-robin order whose queue has
+    // room (waiting for room on that worker if none has).
     virtual void AddTask(Task&& task)
     {
         assert(!stopped_);
-        while (!queues_[rand() % thread_count_].PushNonBlocking(std::forward<Task>(task)))
-        {
-        }
+        uint32 first = next_queue_.fetch_add(1);
+        for (int i = 0; i < thread_count_; i++)
+            if (queues_[(first + i) % thread_count_].PushNonBlocking(std::move(task))) return;
+        queues_[first % thread_count_].Push(std::move(task));
     }
 
-    virtual void AddTask(const Task& task)
-    {
-        assert(!stopped_);
-        while (!queues_[rand() % thread_count_].PushNonBlocking(task))
-        {
-        }
-    }
+    virtual void AddTask(const Task& task) { AddTask(Task(task)); }
 
     virtual int ThreadCount() { return thread_count_; }
+
    private:
+    // Tasks a worker takes off its queue at once.
+    static const int kBatchSize = 16;
+
     void Start()
     {
         threads_.resize(thread_count_);
-        queues_.resize(thread_count_);
-
-        pthread_attr_t attr;
-        pthread_attr_init(&attr);
-
-        #if !defined(_MSC_VER) && !defined(__APPLE__)
-        // Pin all threads in the thread pool to CPU Core 0 ~ 6
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        for (int i = 0; i < 7; i++)
-        {
-            CPU_SET(i, &cpuset);
-        }
-
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
-        #endif
+        queues_ = NewCacheAlignedArray<MPMCQueue<Task>>(thread_count_);
 
         for (int i = 0; i < thread_count_; i++)
         {
-            pthread_create(&threads_[i], &attr, RunThread,
+            pthread_create(&threads_[i], NULL, RunThread,
                            reinterpret_cast<void*>(new pair<int, StaticThreadPool*>(i, this)));
         }
     }
@@ -79,13 +72,17 @@ class StaticThreadPool : public ThreadPool
         int queue_id         = reinterpret_cast<pair<int, StaticThreadPool*>*>(arg)->first;
         StaticThreadPool* tp = reinterpret_cast<pair<int, StaticThreadPool*>*>(arg)->second;
 
-        Task task;
+        tp->SetCurrentThread(queue_id);
+        PlaceCurrentThread(tp->placement_, queue_id);
+
+        Task tasks[kBatchSize];
         int sleep_duration = 1;  // in microseconds
         while (true)
         {
-            if (tp->queues_[queue_id].PopNonBlocking(&task))
+            int n = tp->queues_[queue_id].PopBatch(tasks, kBatchSize);
+            if (n > 0)
             {
-                task();
+                for (int i = 0; i < n; i++) tasks[i]();
                 // Reset backoff.
                 sleep_duration = 1;
             }
@@ -99,9 +96,9 @@ class StaticThreadPool : public ThreadPool
             if (tp->stopped_)
             {
                 // Go through ALL queues looking for a remaining task.
-                while (tp->queues_[queue_id].Pop(&task))
+                while ((n = tp->queues_[queue_id].PopBatch(tasks, kBatchSize)) > 0)
                 {
-                    task();
+                    for (int i = 0; i < n; i++) tasks[i]();
                 }
 
                 break;
@@ -113,128 +110,14 @@ class StaticThreadPool : public ThreadPool
     int thread_count_;
     vector<pthread_t> threads_;
 
-    // Task queues.
-    vector<AtomicQueue<Task>> queues_;
-
-    bool stopped_;
-};
-
-#endif  // _DB_UTILS_STATIC_THREAD_POOL_H_
-/// @file
-/// @author Alexander Thomson <thomson@cs.yale.edu>
-// Modified by: Kun Ren (kun.ren@yale.edu)
-
-#ifndef _DB_UTILS_STATIC_THREAD_POOL_H_
-#define _DB_UTILS_STATIC_THREAD_POOL_H_
-
-#include <queue>
-#include <string>
-#include <utility>
-#include <vector>
-#include "assert.h"
-#include "pthread.h"
-#include "stdlib.h"
-#include "utils/atomic.h"
-#include "utils/thread_pool.h"
-
-using std::queue;
-using std::string;
-using std::vector;
-using std::pair;
-
-//
-class StaticThreadPool : public ThreadPool
-{
-   public:
-    StaticThreadPool(int nthreads) : thread_count_(nthreads), stopped_(false) { Start(); }
-    ~StaticThreadPool()
-    {
-        stopped_ = true;
-        for (int i = 0; i < thread_count_; i++) pthread_join(threads_[i], NULL);
-    }
-
-    bool Active() { return !stopped_; }
-    virtual void RunTask(Task* task)
-    {
-        assert(!stopped_);
-        while (!queues_[rand() % thread_count_].PushNonBlocking(task))
-        {
-        }
-    }
-
-    virtual int ThreadCount() { return thread_count_; }
-   private:
-    void Start()
-    {
-        threads_.resize(thread_count_);
-        queues_.resize(thread_count_);
-
-        pthread_attr_t attr;
-        pthread_attr_init(&attr);
-
-        #if !defined(_MSC_VER) && !defined(__APPLE__)
-        // Pin all threads in the thread pool to CPU Core 0 ~ 6
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        for (int i = 0; i < 19; i++)
-        {
-            CPU_SET(i, &cpuset);
-        }
-
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
-        #endif
-
-        for (int i = 0; i < thread_count_; i++)
-        {
-            pthread_create(&threads_[i], &attr, RunThread,
-                           reinterpret_cast<void*>(new pair<int, StaticThreadPool*>(i, this)));
-        }
-    }
-
-    // Function executed by each pthread.
-    static void* RunThread(void* arg)
-    {
-        int queue_id         = reinterpret_cast<pair<int, StaticThreadPool*>*>(arg)->first;
-        StaticThreadPool* tp = reinterpret_cast<pair<int, StaticThreadPool*>*>(arg)->second;
-
-        Task* task;
-        int sleep_duration = 1;  // in microseconds
-        while (true)
-        {
-            if (tp->queues_[queue_id].PopNonBlocking(&task))
-            {
-                task->Run();
-                delete task;
-                // Reset backoff.
-                sleep_duration = 1;
-            }
-            else
-            {
-                usleep(sleep_duration);
-                // Back off exponentially.
-                if (sleep_duration < 32) sleep_duration *= 2;
-            }
+    // Where the workers run.
+    CpuPlacement placement_;
 
-            if (tp->stopped_)
-            {
-                // Go through ALL queues looking for a remaining task.
-                while (tp->queues_[queue_id].Pop(&task))
-                {
-                    task->Run();
-                    delete task;
-                }
-
-                break;
-            }
-        }
-        return NULL;
-    }
-
-    int thread_count_;
-    vector<pthread_t> threads_;
+    // Task queues, one per worker.
+    MPMCQueue<Task>* queues_;
 
-    // Task queues.
-    vector<AtomicQueue<Task*>> queues_;
+    // Round-robin cursor of AddTask().
+    std::atomic<uint32> next_queue_;
 
     bool stopped_;
 };
@@ -1,6 +1,7 @@
 #ifndef _DB_UTILS_THREAD_POOL_H_
 #define _DB_UTILS_THREAD_POOL_H_
 
+#include <stddef.h>
 #include <functional>
 
 class ThreadPool
@@ -17,6 +18,38 @@ class ThreadPool
     // Returns the number of active physical pthreads currently consituting the
     // threadpool.
     virtual int ThreadCount() = 0;
+
+    // Index (in [0, ThreadCount())) of the thread of this pool running the
+    // caller, or -1 if the caller is not a thread of this pool (it may be one
+    // of another pool).
+    int CurrentThread() const
+    {
+        const ThreadSlot& slot = CurrentThreadSlot();
+        return slot.pool == this ? slot.index : -1;
+    }
+
+   protected:
+    // Called by each pool thread when it starts, with its index.
+    void SetCurrentThread(int index)
+    {
+        ThreadSlot& slot = CurrentThreadSlot();
+        slot.pool        = this;
+        slot.index       = index;
+    }
+
+   private:
+    // The pool a thread belongs to, and its index there.
+    struct ThreadSlot
+    {
+        const ThreadPool* pool;
+        int index;
+    };
+
+    static ThreadSlot& CurrentThreadSlot()
+    {
+        static thread_local ThreadSlot slot = {NULL, -1};
+        return slot;
+    }
 };
 
 #endif  // _DB_UTILS_THREAD_POOL_H_
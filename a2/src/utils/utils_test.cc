@@ -0,0 +1,301 @@
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+#include "utils/epoch_manager.h"
+#include "utils/flat_map.h"
+#include "utils/lock_free_queue.h"
+#include "utils/testing.h"
+#include "utils/work_stealing_thread_pool.h"
+
+TEST(FlatMap_SortedAndSpills)
+{
+    // Inserts out of order, past the inline capacity.
+    FlatMap<Key, Value, 4> map;
+    FlatSet<Key, 4> set;
+    for (Key key = 10; key > 0; key--)
+    {
+        map[key * 3] = key;
+        set.insert(key * 3);
+        set.insert(key * 3);
+    }
+    EXPECT_EQ(map.size(), 10);
+    EXPECT_EQ(set.size(), 10);
+    for (uint32 i = 0; i < set.size(); i++)
+    {
+        EXPECT_EQ(set.data()[i], 3 * (i + 1));
+        EXPECT_EQ(map.begin()[i].first, 3 * (i + 1));
+        EXPECT_EQ(map.begin()[i].second, i + 1);
+    }
+    EXPECT_EQ(map.count(4), 0);
+    EXPECT_EQ(map.count(6), 1);
+    EXPECT_TRUE(set.find(7) == set.end());
+    map[6] = 42;
+    EXPECT_EQ(map.find(6)->second, 42);
+
+    // Copies are independent; cleared containers refill.
+    FlatMap<Key, Value, 4> copy = map;
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(copy.size(), 10);
+    EXPECT_EQ(copy[30], 10);
+    map[1] = 1;
+    EXPECT_EQ(map.size(), 1);
+
+    END;
+}
+
+// Producers push (their index * kItems + i) for i < kItems, alternating
+// single and batch pushes into a queue much smaller than the total.
+struct QueueProducerArgs
+{
+    MPMCQueue<uint64>* queue;
+    uint64 first;
+    int count;
+};
+
+static void* ProduceRange(void* arg)
+{
+    QueueProducerArgs* args = reinterpret_cast<QueueProducerArgs*>(arg);
+    uint64 batch[8];
+    for (int i = 0; i < args->count;)
+    {
+        if (i % 2 == 0)
+        {
+            args->queue->Push(args->first + i++);
+            continue;
+        }
+        int n = 0;
+        while (n < 8 && i + n < args->count)
+        {
+            batch[n] = args->first + i + n;
+            n++;
+        }
+        int pushed = args->queue->PushBatch(batch, n);
+        if (pushed == 0) sched_yield();
+        i += pushed;
+    }
+    return NULL;
+}
+
+TEST(MPMCQueue_ConcurrentPushPop)
+{
+    const int kThreads = 4;
+    const int kItems   = 20000;
+    MPMCQueue<uint64> queue(64);
+
+    std::vector<pthread_t> threads(kThreads);
+    std::vector<QueueProducerArgs> args(kThreads);
+    for (int i = 0; i < kThreads; i++)
+    {
+        args[i].queue = &queue;
+        args[i].first = (uint64)i * kItems;
+        args[i].count = kItems;
+        pthread_create(&threads[i], NULL, ProduceRange, &args[i]);
+    }
+
+    // Each producer's items come out in the order it pushed them.
+    std::vector<uint64> next(kThreads);
+    for (int i = 0; i < kThreads; i++) next[i] = (uint64)i * kItems;
+    bool in_order = true;
+    int popped    = 0;
+    uint64 batch[8];
+    while (popped < kThreads * kItems)
+    {
+        int n = (popped % 3 == 0) ? queue.Pop(&batch[0]) : queue.PopBatch(batch, 8);
+        for (int i = 0; i < n; i++)
+        {
+            uint64& expected = next[batch[i] / kItems];
+            if (batch[i] != expected) in_order = false;
+            expected = batch[i] + 1;
+        }
+        popped += n;
+    }
+    for (int i = 0; i < kThreads; i++) pthread_join(threads[i], NULL);
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(queue.Size(), 0);
+    EXPECT_FALSE(queue.Pop(&batch[0]));
+
+    // A full queue refuses non-blocking pushes.
+    for (uint64 i = 0; i < 64; i++) queue.Push(i);
+    EXPECT_FALSE(queue.PushNonBlocking(64));
+    EXPECT_EQ(queue.PopBatch(batch, 8), 8);
+    EXPECT_EQ(batch[7], 7);
+    EXPECT_EQ(queue.PushBatch(batch, 8), 8);
+    EXPECT_EQ(queue.Size(), 64);
+
+    END;
+}
+
+TEST(SPSCQueue_Batches)
+{
+    SPSCQueue<uint64> queue(8);
+    uint64 items[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    uint64 out[10];
+
+    // Only as many as fit are pushed.
+    EXPECT_EQ(queue.PushBatch(items, 10), 8);
+    EXPECT_FALSE(queue.PushNonBlocking(8));
+    EXPECT_EQ(queue.Size(), 8);
+
+    // Wraps around the ring.
+    EXPECT_EQ(queue.PopBatch(out, 3), 3);
+    EXPECT_EQ(out[2], 2);
+    EXPECT_EQ(queue.PushBatch(items + 8, 2), 2);
+    EXPECT_EQ(queue.PopBatch(out, 10), 7);
+    EXPECT_EQ(out[0], 3);
+    EXPECT_EQ(out[6], 9);
+    EXPECT_FALSE(queue.Pop(out));
+
+    END;
+}
+
+TEST(SpillQueue_NeverBlocks)
+{
+    // Far more pushes than the ring holds, with no consumer running.
+    SpillQueue<uint64> queue(8);
+    for (uint64 i = 0; i < 100; i++) queue.Push(i);
+    EXPECT_EQ(queue.Size(), 100);
+
+    // Everything comes out in order; pushes while spilled queue up behind.
+    uint64 item;
+    bool in_order = true;
+    for (uint64 i = 0; i < 50; i++)
+        if (!queue.Pop(&item) || item != i) in_order = false;
+    queue.Push(100);
+    for (uint64 i = 50; i <= 100; i++)
+        if (!queue.Pop(&item) || item != i) in_order = false;
+    EXPECT_TRUE(in_order);
+    EXPECT_FALSE(queue.Pop(&item));
+    EXPECT_EQ(queue.Size(), 0);
+
+    // Back to the ring once drained.
+    queue.Push(7);
+    EXPECT_TRUE(queue.Pop(&item));
+    EXPECT_EQ(item, 7);
+
+    END;
+}
+
+TEST(WorkStealingThreadPool_RunsEveryTask)
+{
+    const int kTasks = 1000;
+    std::atomic<int> done(0);
+    std::atomic<int> outside(0);
+    {
+        WorkStealingThreadPool pool(4);
+        EXPECT_EQ(pool.CurrentThread(), -1);
+
+        // Each task adds a child task from inside the pool, which lands on
+        // the worker's own deque (or is stolen from there).
+        for (int i = 0; i < kTasks; i++)
+        {
+            pool.AddTask([&pool, &done, &outside]() {
+                if (pool.CurrentThread() < 0) outside++;
+                pool.AddTask([&done]() { done++; });
+                done++;
+            });
+        }
+        while (done.load() < 2 * kTasks) usleep(100);
+
+        // Workers park once idle, and wake up for new tasks.
+        usleep(20000);
+        pool.AddTask([&done]() { done++; });
+        while (done.load() < 2 * kTasks + 1) usleep(100);
+    }
+    EXPECT_EQ(done.load(), 2 * kTasks + 1);
+    EXPECT_EQ(outside.load(), 0);
+
+    END;
+}
+
+TEST(WorkStealingThreadPool_OtherPools)
+{
+    const int kTasks = 1000;
+    std::atomic<int> done(0);
+    std::atomic<int> foreign(0);
+    {
+        WorkStealingThreadPool first(2), second(4);
+
+        // Workers of one pool are outside any other: their tasks for it go
+        // to its inboxes, not to a deque they don't own.
+        for (int i = 0; i < kTasks; i++)
+        {
+            first.AddTask([&first, &second, &done, &foreign]() {
+                if (second.CurrentThread() >= 0 || first.CurrentThread() < 0) foreign++;
+                second.AddTask([&first, &second, &done, &foreign]() {
+                    if (first.CurrentThread() >= 0 || second.CurrentThread() < 0) foreign++;
+                    done++;
+                });
+            });
+        }
+        while (done.load() < kTasks) usleep(100);
+    }
+    EXPECT_EQ(foreign.load(), 0);
+
+    END;
+}
+
+TEST(EpochManager_LowWatermark)
+{
+    EpochManager epochs;
+    EXPECT_EQ(epochs.LowWatermark(), 0);
+
+    uint64 e1 = epochs.Enter(1);
+    uint64 e2 = epochs.Enter(2);
+    EXPECT_EQ(epochs.LowWatermark(), 1);
+
+    // Later epochs don't raise the watermark past the oldest active txn.
+    epochs.Advance();
+    uint64 e5 = epochs.Enter(5);
+    EXPECT_EQ(epochs.LowWatermark(), 1);
+    EXPECT_EQ(epochs.OldestActive(0), 0);
+
+    epochs.Exit(e1);
+    epochs.Exit(e2);
+    EXPECT_EQ(epochs.LowWatermark(), 5);
+    epochs.Exit(e5);
+    EXPECT_EQ(epochs.LowWatermark(), 6);
+
+    END;
+}
+
+TEST(EpochManager_SlotReuse)
+{
+    // A slot that drains and refills within one epoch forgets the drained
+    // txns' timestamps.
+    EpochManager epochs;
+    epochs.Exit(epochs.Enter(3));
+    EXPECT_EQ(epochs.LowWatermark(), 4);
+    uint64 e9 = epochs.Enter(9);
+    EXPECT_EQ(epochs.LowWatermark(), 9);
+    EXPECT_EQ(epochs.OldestActive(100), 9);
+    epochs.Exit(e9);
+
+    // Epoch 64 reuses slot 0, which no txn entered in epoch 0.
+    EpochManager later(1);
+    later.Advance();
+    later.Exit(later.Enter(5));
+    for (int i = 0; i < 63; i++) later.Advance();
+    uint64 e100 = later.Enter(100);
+    EXPECT_EQ(e100, 64);
+    EXPECT_EQ(later.LowWatermark(), 100);
+    later.Exit(e100);
+
+    END;
+}
+
+int main(int argc, char** argv)
+{
+    FlatMap_SortedAndSpills();
+    MPMCQueue_ConcurrentPushPop();
+    SPSCQueue_Batches();
+    SpillQueue_NeverBlocks();
+    WorkStealingThreadPool_RunsEveryTask();
+    WorkStealingThreadPool_OtherPools();
+    EpochManager_LowWatermark();
+    EpochManager_SlotReuse();
+}
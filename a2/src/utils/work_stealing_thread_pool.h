@@ -0,0 +1,305 @@
+#ifndef _DB_UTILS_WORK_STEALING_THREAD_POOL_H_
+#define _DB_UTILS_WORK_STEALING_THREAD_POOL_H_
+
+#include <sched.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include "assert.h"
+#include "pthread.h"
+
+#include "utils/common.h"
+#include "utils/cpu_affinity.h"
+#include "utils/event_count.h"
+#include "utils/lock_free_queue.h"
+#include "utils/object_pool.h"
+#include "utils/thread_pool.h"
+
+using std::pair;
+using std::vector;
+
+/// @class WorkStealingDeque<T>
+///
+/// Bounded Chase-Lev deque of T*'s. Its owner thread pushes and pops at the
+/// bottom (LIFO); any other thread steals from the top (FIFO). Owner
+/// operations only synchronize with thieves when they race for the last
+/// element.
+template <typename T>
+class WorkStealingDeque
+{
+   public:
+    static const int64 kCapacity = 1 << 12;
+
+    WorkStealingDeque() : top_(0), bottom_(0)
+    {
+        for (int64 i = 0; i < kCapacity; i++) items_[i].store(NULL, std::memory_order_relaxed);
+    }
+
+    // Returns the (approximate) number of elements.
+    int64 Size() const
+    {
+        int64 size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+        return size < 0 ? 0 : size;
+    }
+
+    // Pushes 'item' at the bottom and returns true, or returns false if the
+    // deque is full. Owner only.
+    bool Push(T* item)
+    {
+        int64 b = bottom_.load(std::memory_order_relaxed);
+        int64 t = top_.load(std::memory_order_acquire);
+        if (b - t >= kCapacity) return false;
+        items_[b & (kCapacity - 1)].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Pops the bottom (most recently pushed) element, or returns NULL if the
+    // deque is empty. Owner only.
+    T* Pop()
+    {
+        int64 b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 t = top_.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return NULL;
+        }
+        T* item = items_[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // Last element: race the thieves for it.
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = NULL;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Takes the top (least recently pushed) element, or returns NULL if the
+    // deque is empty or another thread got it first. Any thread.
+    T* Steal()
+    {
+        int64 t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return NULL;
+        T* item = items_[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL;
+        return item;
+    }
+
+   private:
+    std::atomic<int64> top_;
+    char pad0_[CACHE_LINE_SIZE - sizeof(std::atomic<int64>)];
+    std::atomic<int64> bottom_;
+    char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<int64>)];
+    std::atomic<T*> items_[kCapacity];
+};
+
+/// @class WorkStealingThreadPool
+///
+/// ThreadPool whose workers balance load among themselves. Each worker owns
+/// a WorkStealingDeque for the tasks it adds itself, which it runs LIFO
+/// (while their data is still in cache), and an inbox for tasks added by
+/// threads outside the pool. A worker with nothing of its own steals, FIFO,
+/// from the other workers' deques and inboxes, starting at a random victim.
+///
+/// An idle worker spins for a while, then yields the CPU for a while, and
+/// then parks on an EventCount that AddTask() notifies; a parked worker costs
+/// no CPU, and AddTask() only pays for a wake-up when some worker is parked.
+///
+/// Workers run where 'placement' puts them, and each allocates its own deque
+/// and inbox once it got there, so they live on the worker's NUMA node.
+class WorkStealingThreadPool : public ThreadPool
+{
+   public:
+    WorkStealingThreadPool(int nthreads, const CpuPlacement& placement = CpuPlacement())
+        : thread_count_(nthreads), placement_(placement), started_(0), next_inbox_(0), stopped_(false)
+    {
+        Start();
+    }
+    ~WorkStealingThreadPool()
+    {
+        stopped_.store(true);
+        idle_.NotifyAll();
+        for (int i = 0; i < thread_count_; i++) pthread_join(threads_[i], NULL);
+        for (int i = 0; i < thread_count_; i++) DeleteCacheAlignedArray(workers_[i], 1);
+    }
+
+    bool Active() { return !stopped_; }
+
+    // From a pool thread, pushes 'task' onto that thread's own deque (it
+    // will run next unless stolen); from any other thread, queues it in the
+    // inboxes round-robin.
+    virtual void AddTask(Task&& task)
+    {
+        assert(!stopped_);
+        Task* item = tasks_.New();
+        *item      = std::move(task);
+
+        int self = CurrentThread();
+        if (self < 0 || !workers_[self]->deque_.Push(item))
+        {
+            uint32 first = next_inbox_.fetch_add(1);
+            bool queued  = false;
+            for (int i = 0; i < thread_count_ && !queued; i++)
+                queued = workers_[(first + i) % thread_count_]->inbox_.PushNonBlocking(item);
+            if (!queued) workers_[first % thread_count_]->inbox_.Push(item);
+        }
+        idle_.NotifyOne();
+    }
+
+    virtual void AddTask(const Task& task) { AddTask(Task(task)); }
+
+    virtual int ThreadCount() { return thread_count_; }
+
+   private:
+    // Idle policy: rounds of looking for work (with a pause in between)
+    // before yielding, and then yields before parking.
+    static const int kSpinRounds  = 128;
+    static const int kYieldRounds = 16;
+
+    struct alignas(CACHE_LINE_SIZE) Worker
+    {
+        Worker() : rand_state_(0) {}
+        WorkStealingDeque<Task> deque_;
+        MPMCQueue<Task*> inbox_;
+        uint32 rand_state_;  // Victim selection (xorshift); owner only.
+    };
+
+    void Start()
+    {
+        threads_.resize(thread_count_);
+        workers_.resize(thread_count_);
+        for (int i = 0; i < thread_count_; i++)
+        {
+            pthread_create(&threads_[i], NULL, RunThread,
+                           reinterpret_cast<void*>(new pair<int, WorkStealingThreadPool*>(i, this)));
+        }
+
+        // Tasks may only be added once every worker has its deque and inbox.
+        while (started_.load() < thread_count_) sched_yield();
+    }
+
+    // Returns a task for worker 'self' to run, or NULL if none was found.
+    Task* FindTask(int self)
+    {
+        Worker& worker = *workers_[self];
+        Task* task     = worker.deque_.Pop();
+        if (task != NULL || worker.inbox_.Pop(&task)) return task;
+
+        uint32& x = worker.rand_state_;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        for (int i = 0; i < thread_count_; i++)
+        {
+            Worker& victim = *workers_[(x + i) % thread_count_];
+            if (&victim == &worker) continue;
+            if ((task = victim.deque_.Steal()) != NULL || victim.inbox_.Pop(&task)) return task;
+        }
+        return NULL;
+    }
+
+    // True if no deque or inbox holds a task.
+    bool Empty()
+    {
+        for (int i = 0; i < thread_count_; i++)
+            if (workers_[i]->deque_.Size() != 0 || workers_[i]->inbox_.Size() != 0) return false;
+        return true;
+    }
+
+    void Run(Task* task)
+    {
+        (*task)();
+        tasks_.Delete(task);
+    }
+
+    // Function executed by each pthread.
+    static void* RunThread(void* arg)
+    {
+        int self                   = reinterpret_cast<pair<int, WorkStealingThreadPool*>*>(arg)->first;
+        WorkStealingThreadPool* tp = reinterpret_cast<pair<int, WorkStealingThreadPool*>*>(arg)->second;
+        delete reinterpret_cast<pair<int, WorkStealingThreadPool*>*>(arg);
+
+        tp->SetCurrentThread(self);
+        PlaceCurrentThread(tp->placement_, self);
+        tp->workers_[self] = NewCacheAlignedArray<Worker>(1);
+        tp->workers_[self]->rand_state_ = 2654435761u * (self + 1);
+        tp->started_.fetch_add(1);
+
+        // Stealing needs everyone else's deque and inbox as well.
+        while (tp->started_.load() < tp->thread_count_) sched_yield();
+
+        int idle_rounds = 0;
+        while (true)
+        {
+            Task* task = tp->FindTask(self);
+            if (task != NULL)
+            {
+                tp->Run(task);
+                idle_rounds = 0;
+                continue;
+            }
+
+            // Run every remaining task before stopping.
+            if (tp->stopped_.load() && tp->Empty()) break;
+
+            if (idle_rounds < kSpinRounds)
+            {
+                idle_rounds++;
+                CpuRelax();
+            }
+            else if (idle_rounds < kSpinRounds + kYieldRounds)
+            {
+                idle_rounds++;
+                sched_yield();
+            }
+            else
+            {
+                uint32 ticket = tp->idle_.PrepareWait();
+                if ((task = tp->FindTask(self)) != NULL || tp->stopped_.load())
+                {
+                    tp->idle_.CancelWait();
+                    if (task != NULL) tp->Run(task);
+                }
+                else
+                {
+                    tp->idle_.Wait(ticket);
+                }
+                idle_rounds = 0;
+            }
+        }
+        return NULL;
+    }
+
+    int thread_count_;
+    vector<pthread_t> threads_;
+
+    // Where the workers run.
+    CpuPlacement placement_;
+
+    // Per-worker task deques and inboxes, each allocated by its worker.
+    vector<Worker*> workers_;
+
+    // Number of workers that allocated theirs.
+    std::atomic<int> started_;
+
+    // Storage of queued tasks (deques hold pointers).
+    ObjectPool<Task> tasks_;
+
+    // Round-robin cursor of AddTask() calls from outside the pool.
+    std::atomic<uint32> next_inbox_;
+
+    // Where idle workers park.
+    EventCount idle_;
+
+    std::atomic<bool> stopped_;
+};
+
+#endif  // _DB_UTILS_WORK_STEALING_THREAD_POOL_H_